@@ -23,10 +23,20 @@
 // THE SOFTWARE.
 
 #include "sqlite3pp.h"
+#include <algorithm>
+#include <cctype>
 #include <cstring>
+#include <fstream>
 #include <memory>
 #include <assert.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace sqlite3pp
 {
 
@@ -181,6 +191,95 @@ namespace sqlite3pp
     return check(rc);
   }
 
+  int database::backup(std::vector<backup_target> const& targets, char const* dbname, int step_page)
+  {
+    if (step_page <= 0) {
+      // cache_size is in pages, or in KiB when negative.
+      long long int cache_pages = 0;
+      int page_size = 0;
+      {
+        query qry(*this, (std::string("PRAGMA \"") + dbname + "\".cache_size").c_str());
+        for (auto row : qry) cache_pages = row.get<long long int>(0);
+      }
+      {
+        query qry(*this, (std::string("PRAGMA \"") + dbname + "\".page_size").c_str());
+        for (auto row : qry) page_size = row.get<int>(0);
+      }
+      if (cache_pages < 0 && page_size > 0)
+        cache_pages = -cache_pages * 1024 / page_size;
+      step_page = int(std::max(cache_pages / 2, 1LL));
+    }
+
+    std::vector<sqlite3_backup*> bkups;
+    for (auto& t : targets) {
+      auto bkup = sqlite3_backup_init(t.destdb.db_, t.destdbname, db_, dbname);
+      if (!bkup) {
+        auto rc = t.destdb.error_code();
+        for (auto b : bkups)
+          sqlite3_backup_finish(b);
+        return check(rc);
+      }
+      bkups.push_back(bkup);
+    }
+
+    auto pending = [](int rc) {return rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED;};
+    std::vector<int> rcs(bkups.size(), SQLITE_OK);
+    for (bool active = !bkups.empty(); active; ) {
+      active = false;
+      for (size_t i = 0; i < bkups.size(); ++i) {
+        if (!pending(rcs[i]))
+          continue;
+        rcs[i] = sqlite3_backup_step(bkups[i], step_page);
+        if (targets[i].h) {
+          targets[i].h(sqlite3_backup_remaining(bkups[i]), sqlite3_backup_pagecount(bkups[i]), rcs[i]);
+        }
+        active = active || pending(rcs[i]);
+      }
+    }
+
+    auto rc = SQLITE_OK;
+    for (size_t i = 0; i < bkups.size(); ++i) {
+      sqlite3_backup_finish(bkups[i]);
+      if (rc == SQLITE_OK && rcs[i] != SQLITE_DONE)
+        rc = rcs[i];
+    }
+    return check(rc);
+  }
+
+  database_image database::serialize(char const* dbname, unsigned flags)
+  {
+    sqlite3_int64 size = 0;
+    auto data = sqlite3_serialize(db_, dbname, &size, flags);
+    if (!data) {
+      if (!(flags & SQLITE_SERIALIZE_NOCOPY))
+        throw database_error("cannot serialize the database", SQLITE_NOMEM);
+      return database_image();
+    }
+    return database_image(data, size_t(size), flags & SQLITE_SERIALIZE_NOCOPY ? database_image::borrowed : database_image::owned);
+  }
+
+  int database::deserialize(database_image&& image, char const* dbname)
+  {
+    if (image.kind_ != database_image::owned)
+      return deserialize(static_cast<database_image const&>(image), dbname);
+
+    // A WAL database's header makes the in-memory copy unreadable; switch it to rollback mode.
+    if (image.size_ > 19 && image.data_[18] == 2 && image.data_[19] == 2)
+      image.data_[18] = image.data_[19] = 1;
+    auto rc = sqlite3_deserialize(db_, dbname, image.data_, image.size_, image.size_,
+                                  SQLITE_DESERIALIZE_FREEONCLOSE | SQLITE_DESERIALIZE_RESIZEABLE);
+    // The memory is freed by SQLite even if this fails.
+    image.kind_ = database_image::none;
+    image.reset();
+    return check(rc);
+  }
+
+  int database::deserialize(database_image const& image, char const* dbname)
+  {
+    auto data = const_cast<unsigned char*>(image.data_);
+    return check(sqlite3_deserialize(db_, dbname, data, image.size_, image.size_, SQLITE_DESERIALIZE_READONLY));
+  }
+
   void database::set_busy_handler(busy_handler h)
   {
     bh_ = h;
@@ -292,6 +391,14 @@ namespace sqlite3pp
     }
   }
 
+  statement::statement(statement&& other)
+  : checking(other), stmt_(other.stmt_), tail_(other.tail_), shared_(other.shared_),
+    pool_(std::move(other.pool_)), parameters_(std::move(other.parameters_))
+  {
+    other.stmt_ = nullptr;
+    other.tail_ = nullptr;
+  }
+
   statement::~statement()
   {
     // finish() can return error. If you want to check the error, call
@@ -311,12 +418,16 @@ namespace sqlite3pp
   int statement::prepare_impl(char const* stmt)
   {
     shared_ = false;
+    pool_.reset();
+    parameters_.reset();
     return sqlite3_prepare_v2(db_.db_, stmt, int(std::strlen(stmt)), &stmt_, &tail_);
   }
 
   void statement::share(const statement& other) {
     finish();
     stmt_ = other.stmt_;
+    pool_.reset();
+    parameters_ = other.parameters_;
     shared_ = true;
     unbind();
   }
@@ -327,12 +438,16 @@ namespace sqlite3pp
     if (stmt_) {
       if (shared_) {
         reset();
+      } else if (pool_) {
+        pool_->checkin(stmt_);
+        pool_.reset();
       } else {
         rc = finish_impl(stmt_);
       }
       stmt_ = nullptr;
     }
     tail_ = nullptr;
+    parameters_.reset();
 
     return check(rc);
   }
@@ -426,52 +541,63 @@ namespace sqlite3pp
 
   int statement::bind(char const* name, int value)
   {
-    auto idx = sqlite3_bind_parameter_index(stmt_, name);
+    auto idx = parameter_index(name);
     return bind(idx, value);
   }
 
   int statement::bind(char const* name, double value)
   {
-    auto idx = sqlite3_bind_parameter_index(stmt_, name);
+    auto idx = parameter_index(name);
     return bind(idx, value);
   }
 
   int statement::bind(char const* name, long int value)
   {
-    auto idx = sqlite3_bind_parameter_index(stmt_, name);
+    auto idx = parameter_index(name);
     return bind(idx, value);
   }
 
   int statement::bind(char const* name, long long int value)
   {
-    auto idx = sqlite3_bind_parameter_index(stmt_, name);
+    auto idx = parameter_index(name);
     return bind(idx, value);
   }
 
   int statement::bind(char const* name, char const* value, copy_semantic fcopy)
   {
-    auto idx = sqlite3_bind_parameter_index(stmt_, name);
+    auto idx = parameter_index(name);
     return bind(idx, value, fcopy);
   }
 
   int statement::bind(char const* name, void const* value, int n, copy_semantic fcopy)
   {
-    auto idx = sqlite3_bind_parameter_index(stmt_, name);
+    auto idx = parameter_index(name);
     return bind(idx, value, n, fcopy);
   }
 
   int statement::bind(char const* name, std::string_view value, copy_semantic fcopy)
   {
-    auto idx = sqlite3_bind_parameter_index(stmt_, name);
+    auto idx = parameter_index(name);
     return bind(idx, value, fcopy);
   }
 
   int statement::bind(char const* name)
   {
-    auto idx = sqlite3_bind_parameter_index(stmt_, name);
+    auto idx = parameter_index(name);
     return bind(idx);
   }
 
+  int statement::bind(int idx, zeroblob value)
+  {
+    return check(sqlite3_bind_zeroblob64(stmt_, idx, value.size));
+  }
+
+  int statement::bind(char const* name, zeroblob value)
+  {
+    auto idx = parameter_index(name);
+    return bind(idx, value);
+  }
+
   int statement::bind(char const* name, null_type)
   {
     return bind(name);
@@ -479,10 +605,92 @@ namespace sqlite3pp
 
   statement::bindref statement::operator[] (char const *name)
   {
-    auto idx = sqlite3_bind_parameter_index(stmt_, name);
+    auto idx = parameter_index(name);
     return bindref(*this, idx);
   }
 
+  void statement::check_parameters(int count) const
+  {
+    auto n = sqlite3_bind_parameter_count(stmt_);
+    if (n != count) {
+      auto msg = "statement has " + std::to_string(n) + " parameters, expected " + std::to_string(count);
+      throw database_error(msg.c_str(), SQLITE_RANGE);
+    }
+  }
+
+  int statement::parameter_index(parameter key)
+  {
+    if (!parameters_) {
+      if (!stmt_)
+        return 0;
+      parameters_ = pool_ ? pool_->parameters(stmt_) : std::make_shared<parameter_table const>(stmt_);
+    }
+    return parameters_->find(key);
+  }
+
+  parameter_table::parameter_table(sqlite3_stmt* stmt)
+  {
+    auto n = sqlite3_bind_parameter_count(stmt);
+    size_t size = 8;
+    while (size < size_t(n) * 2)
+      size *= 2;
+    slots_.resize(size, slot{0, 0});
+    names_.resize(n);
+    auto mask = size - 1;
+    for (int idx = 1; idx <= n; ++idx) {
+      auto name = sqlite3_bind_parameter_name(stmt, idx);
+      if (!name) // nameless "?"
+        continue;
+      names_[idx - 1] = name;
+      auto hash = parameter::hash_of(name);
+      auto i = hash & mask;
+      while (slots_[i].idx)
+        i = (i + 1) & mask;
+      slots_[i] = slot{hash, idx};
+    }
+  }
+
+  int parameter_table::find(parameter key) const
+  {
+    auto mask = slots_.size() - 1;
+    for (auto i = key.hash & mask; slots_[i].idx; i = (i + 1) & mask) {
+      if (slots_[i].hash == key.hash && names_[slots_[i].idx - 1] == key.name)
+        return slots_[i].idx;
+    }
+    return 0;
+  }
+
+  statement_pool::~statement_pool()
+  {
+    for (auto stmt : idle_)
+      sqlite3_finalize(stmt);
+  }
+
+  sqlite3_stmt* statement_pool::checkout()
+  {
+    if (idle_.empty())
+      return nullptr;
+    auto stmt = idle_.back();
+    idle_.pop_back();
+    memory_ -= sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_MEMUSED, 0);
+    return stmt;
+  }
+
+  std::shared_ptr<parameter_table const> statement_pool::parameters(sqlite3_stmt* stmt)
+  {
+    if (!parameters_)
+      parameters_ = std::make_shared<parameter_table const>(stmt);
+    return parameters_;
+  }
+
+  void statement_pool::checkin(sqlite3_stmt* stmt)
+  {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    memory_ += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_MEMUSED, 0);
+    idle_.push_back(stmt);
+  }
+
   command::bindstream::bindstream(command& cmd, int idx) : cmd_(cmd), idx_(idx)
   {
   }
@@ -690,6 +898,108 @@ namespace sqlite3pp
     return query_iterator();
   }
 
+  namespace
+  {
+    // Storage kind for a column of the given declared type, using SQLite's affinity rules.
+    int column_kind(char const* decl)
+    {
+      std::string type(decl);
+      for (auto& c : type)
+        c = char(toupper((unsigned char)c));
+      if (type.find("INT") != std::string::npos)
+        return SQLITE_INTEGER;
+      if (type.find("CHAR") != std::string::npos || type.find("CLOB") != std::string::npos
+          || type.find("TEXT") != std::string::npos)
+        return SQLITE_TEXT;
+      if (type.empty() || type.find("BLOB") != std::string::npos)
+        return SQLITE_BLOB;
+      return SQLITE_FLOAT;
+    }
+  }
+
+  size_t query::fetch_columns(column_batch& batch, size_t max_rows)
+  {
+    auto ncols = column_count();
+    if (batch.columns_.size() != size_t(ncols))
+      batch.columns_.assign(ncols, {});
+    for (auto& col : batch.columns_) {
+      col.integers.clear();
+      col.reals.clear();
+      col.offsets.assign(1, 0);
+      col.data.clear();
+      col.nulls.clear();
+    }
+
+    size_t row = 0;
+    for (; row < max_rows; ++row) {
+      auto rc = step();
+      if (rc == SQLITE_DONE)
+        break;
+      if (rc != SQLITE_ROW)
+        throw_(rc);
+
+      if (row % 64 == 0) {
+        for (auto& col : batch.columns_)
+          col.nulls.push_back(0);
+      }
+      for (int idx = 0; idx < ncols; ++idx) {
+        auto& col = batch.columns_[idx];
+        auto type = sqlite3_column_type(stmt_, idx);
+        if (col.type == SQLITE_NULL) {
+          char const* decl = column_decltype(idx);
+          col.type = decl ? column_kind(decl) : (type == SQLITE_NULL ? SQLITE_TEXT : type);
+        }
+        if (type == SQLITE_NULL)
+          col.nulls.back() |= uint64_t(1) << (row % 64);
+        switch (col.type) {
+          case SQLITE_INTEGER:
+            col.integers.push_back(sqlite3_column_int64(stmt_, idx));
+            break;
+          case SQLITE_FLOAT:
+            col.reals.push_back(sqlite3_column_double(stmt_, idx));
+            break;
+          case SQLITE_TEXT: {
+            auto text = reinterpret_cast<char const*>(sqlite3_column_text(stmt_, idx));
+            if (text)
+              col.data.append(text, size_t(sqlite3_column_bytes(stmt_, idx)));
+            col.offsets.push_back(col.data.size());
+            break;
+          }
+          default: {
+            auto data = static_cast<char const*>(sqlite3_column_blob(stmt_, idx));
+            if (data)
+              col.data.append(data, size_t(sqlite3_column_bytes(stmt_, idx)));
+            col.offsets.push_back(col.data.size());
+            break;
+          }
+        }
+      }
+    }
+    batch.rows_ = row;
+    return row;
+  }
+
+  void query::check_columns(std::initializer_list<bool> numeric) const
+  {
+    if (column_count() != int(numeric.size())) {
+      auto msg = "query has " + std::to_string(column_count()) + " columns, expected " + std::to_string(numeric.size());
+      throw database_error(msg.c_str(), SQLITE_MISMATCH);
+    }
+    int idx = 0;
+    for (bool n : numeric) {
+      // Expressions have no declared type, and untyped columns can hold anything.
+      char const* decl = column_decltype(idx);
+      if (n && decl && *decl) {
+        auto kind = column_kind(decl);
+        if (kind == SQLITE_TEXT || kind == SQLITE_BLOB) {
+          auto msg = std::string("column ") + column_name(idx) + " is declared " + decl + ", not numeric";
+          throw database_error(msg.c_str(), SQLITE_MISMATCH);
+        }
+      }
+      ++idx;
+    }
+  }
+
 
   transaction::transaction(database& db, bool fcommit, bool freserve)
   : checking(db), active_(true), fcommit_(fcommit)
@@ -735,7 +1045,7 @@ namespace sqlite3pp
   : checking(db), active_(true), fcommit_(fcommit)
   {
     exceptions(db.exceptions());
-    int rc = execute("SAVEPOINT x");
+    int rc = execute("SAVEPOINT");
     if (rc != SQLITE_OK)
       throw_(rc);
   }
@@ -778,6 +1088,116 @@ namespace sqlite3pp
   }
 
 
+  bulk_loader::bulk_loader(database& db, std::string table, std::vector<std::string> columns,
+                           size_t max_block_rows, char const* verb)
+  : db_(db), table_(std::move(table)), columns_(std::move(columns)), verb_(verb),
+    cache_(db, 64)
+  {
+    if (columns_.empty())
+      throw database_error("bulk_loader needs at least one column", SQLITE_MISUSE);
+    size_t max_vars = sqlite3_limit(db.sqlite3_handle(), SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+    block_rows_ = std::max(size_t(1), std::min(max_block_rows, max_vars / columns_.size()));
+  }
+
+  std::string const& bulk_loader::sql(size_t nrows)
+  {
+    auto& sql = sql_[nrows];
+    if (!sql.empty())
+      return sql;
+
+    std::string row = "(?";
+    for (size_t c = 1; c < columns_.size(); ++c)
+      row += ",?";
+    row += ")";
+
+    sql = verb_ + " INTO " + table_ + " (";
+    for (size_t c = 0; c < columns_.size(); ++c) {
+      if (c > 0)
+        sql += ", ";
+      sql += columns_[c];
+    }
+    sql += ") VALUES ";
+    sql.reserve(sql.size() + nrows * (row.size() + 1));
+    for (size_t r = 0; r < nrows; ++r) {
+      if (r > 0)
+        sql += ",";
+      sql += row;
+    }
+    return sql;
+  }
+
+  database_image::database_image(database_image&& other) noexcept
+    : data_(other.data_), size_(other.size_), kind_(other.kind_)
+  {
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.kind_ = none;
+  }
+
+  database_image& database_image::operator=(database_image&& other) noexcept
+  {
+    if (this != &other) {
+      reset();
+      std::swap(data_, other.data_);
+      std::swap(size_, other.size_);
+      std::swap(kind_, other.kind_);
+    }
+    return *this;
+  }
+
+  database_image::~database_image()
+  {
+    reset();
+  }
+
+  void database_image::reset()
+  {
+    if (kind_ == owned)
+      sqlite3_free(data_);
+#ifndef _WIN32
+    else if (kind_ == mapped)
+      munmap(data_, size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    kind_ = none;
+  }
+
+  database_image database_image::load(char const* path)
+  {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+      throw database_error((std::string("cannot open ") + path).c_str(), SQLITE_CANTOPEN);
+    auto size = size_t(in.tellg());
+    auto data = static_cast<unsigned char*>(sqlite3_malloc64(size ? size : 1));
+    if (!data)
+      throw database_error("out of memory", SQLITE_NOMEM);
+    database_image image(data, size, owned);
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(data), std::streamsize(size)))
+      throw database_error((std::string("cannot read ") + path).c_str(), SQLITE_IOERR);
+    return image;
+  }
+
+  database_image database_image::map(char const* path)
+  {
+#ifndef _WIN32
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+      throw database_error((std::string("cannot open ") + path).c_str(), SQLITE_CANTOPEN);
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+      data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+      throw database_error((std::string("cannot map ") + path).c_str(), SQLITE_IOERR);
+    return database_image(static_cast<unsigned char*>(data), size_t(st.st_size), mapped);
+#else
+    throw database_error((std::string("cannot map ") + path + ": not supported").c_str(), SQLITE_CANTOPEN);
+#endif
+  }
+
   database_error::database_error(char const* msg, int rc) : std::runtime_error(msg), error_code(rc)
   {
   }
@@ -791,6 +1211,7 @@ namespace sqlite3pp
                            const char *database,
                            const char* table, const char *column, int64_t rowid,
                            bool writeable)
+  : db_(db)
   {
     int rc = sqlite3_blob_open(db.db_, database, table, column, rowid, writeable, &blob_);
     if (rc != SQLITE_OK)
@@ -810,5 +1231,138 @@ namespace sqlite3pp
     return len;
   }
 
+  int64_t blob_handle::write(void const* src, size_t len, uint64_t offset) {
+    if (offset + len > size_) {
+      if (offset >= size_)
+        return -1;
+      len = size_ - offset;
+    }
+    if (sqlite3_blob_write(blob_, src, int(len), int(offset)) != SQLITE_OK) {
+      return -1;
+    }
+    return len;
+  }
+
+  void blob_handle::reopen(int64_t rowid) {
+    int rc = sqlite3_blob_reopen(blob_, rowid);
+    if (rc != SQLITE_OK) {
+      size_ = 0;
+      throw database_error(db_, rc);
+    }
+    size_ = sqlite3_blob_bytes(blob_);
+  }
+
+
+  blob_streambuf::blob_streambuf(blob_handle& blob, size_t buffer_size)
+  : blob_(blob), buffer_(buffer_size ? buffer_size : 1)
+  {
+  }
+
+  blob_streambuf::~blob_streambuf()
+  {
+    flush();
+  }
+
+  uint64_t blob_streambuf::position() const
+  {
+    if (pbase())
+      return offset_ + (pptr() - pbase());
+    return offset_ + (gptr() - eback());
+  }
+
+  bool blob_streambuf::flush()
+  {
+    auto pos = position();
+    bool ok = true;
+    if (pbase() && pptr() > pbase()) {
+      auto len = pptr() - pbase();
+      ok = blob_.write(pbase(), len, offset_) == len;
+    }
+    setp(nullptr, nullptr);
+    setg(nullptr, nullptr, nullptr);
+    offset_ = pos;
+    return ok;
+  }
+
+  blob_streambuf::int_type blob_streambuf::underflow()
+  {
+    if (gptr() < egptr())
+      return traits_type::to_int_type(*gptr());
+    if (!flush())
+      return traits_type::eof();
+    auto n = blob_.read(buffer_.data(), buffer_.size(), offset_);
+    if (n <= 0)
+      return traits_type::eof();
+    setg(buffer_.data(), buffer_.data(), buffer_.data() + n);
+    return traits_type::to_int_type(*gptr());
+  }
+
+  blob_streambuf::int_type blob_streambuf::overflow(int_type ch)
+  {
+    if (!flush() || offset_ >= blob_.size())
+      return traits_type::eof();
+    auto room = std::min<uint64_t>(buffer_.size(), blob_.size() - offset_);
+    setp(buffer_.data(), buffer_.data() + room);
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(ch);
+      pbump(1);
+    }
+    return traits_type::not_eof(ch);
+  }
+
+  int blob_streambuf::sync()
+  {
+    return flush() ? 0 : -1;
+  }
+
+  std::streamsize blob_streambuf::xsgetn(char* s, std::streamsize n)
+  {
+    std::streamsize done = std::min<std::streamsize>(n, egptr() - gptr());
+    if (done > 0) {
+      std::memcpy(s, gptr(), size_t(done));
+      gbump(int(done));
+    }
+    if (n - done < std::streamsize(buffer_.size()))
+      return done + std::streambuf::xsgetn(s + done, n - done);
+
+    if (!flush())
+      return done;
+    auto len = blob_.read(s + done, size_t(n - done), offset_);
+    if (len > 0) {
+      offset_ += len;
+      done += len;
+    }
+    return done;
+  }
+
+  std::streamsize blob_streambuf::xsputn(char const* s, std::streamsize n)
+  {
+    if (n < std::streamsize(buffer_.size()))
+      return std::streambuf::xsputn(s, n);
+
+    if (!flush())
+      return 0;
+    auto len = blob_.write(s, size_t(n), offset_);
+    if (len <= 0)
+      return 0;
+    offset_ += len;
+    return len;
+  }
+
+  blob_streambuf::pos_type blob_streambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode)
+  {
+    off_type base = dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? off_type(position()) : off_type(blob_.size());
+    auto target = base + off;
+    if (!flush() || target < 0 || uint64_t(target) > blob_.size())
+      return pos_type(off_type(-1));
+    offset_ = uint64_t(target);
+    return pos_type(target);
+  }
+
+  blob_streambuf::pos_type blob_streambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+  {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+
 
 } // namespace sqlite3pp
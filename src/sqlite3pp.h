@@ -30,13 +30,25 @@
 #define SQLITE3PP_VERSION_MINOR 1
 #define SQLITE3PP_VERSION_PATCH 0
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
+#include <initializer_list>
 #include <iterator>
+#include <list>
+#include <map>
+#include <limits>
+#include <optional>
+#include <memory>
 #include <stdexcept>
+#include <streambuf>
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #ifdef SQLITE3PP_LOADABLE_EXTENSION
 
@@ -98,6 +110,40 @@ namespace sqlite3pp
     bool exceptions_ = false;
   };
 
+  /** A serialized database: memory from `database::serialize()`, a file read into memory by
+      `load()`, or a file mapped read-only by `map()`. Owned memory is freed, and mappings
+      unmapped, when the image is destructed, unless it was handed to
+      `database::deserialize()`. */
+  class database_image
+  {
+   public:
+    database_image() = default;
+    database_image(database_image&& other) noexcept;
+    database_image& operator=(database_image&& other) noexcept;
+    ~database_image();
+
+    /// Reads a database file into memory that `database::deserialize()` can take over.
+    static database_image load(char const* path);
+    /** Maps a database file read-only, for zero-copy read-only deserialization. The file
+        must not be in WAL mode. POSIX only. */
+    static database_image map(char const* path);
+
+    unsigned char const* data() const       {return data_;}
+    size_t size() const                     {return size_;}
+    bool empty() const                      {return size_ == 0;}
+
+   private:
+    friend class database;
+    enum kind { none, owned, borrowed, mapped };
+
+    database_image(unsigned char* data, size_t size, kind k) : data_(data), size_(size), kind_(k) {}
+    void reset();
+
+    unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    kind kind_ = none;
+  };
+
   class database : public checking, noncopyable
   {
     friend class statement;
@@ -115,6 +161,14 @@ namespace sqlite3pp
     using authorize_handler = std::function<int (int, char const*, char const*, char const*, char const*)>;
     using backup_handler = std::function<void (int, int, int)>;
 
+    /** One destination of a fan-out backup, with its own progress handler. */
+    struct backup_target
+    {
+      database& destdb;
+      backup_handler h = {};
+      char const* destdbname = "main";
+    };
+
     explicit database(char const* dbname = nullptr, int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, const char* vfs = nullptr);
 
     database(database&& db);
@@ -132,6 +186,20 @@ namespace sqlite3pp
 
     int backup(database& destdb, backup_handler h = {});
     int backup(char const* dbname, database& destdb, char const* destdbname, backup_handler h, int step_page = 5);
+    /** Backs up to several destinations in lockstep: every destination copies a batch of
+        `step_page` pages before the next batch is started, so each source page is read once
+        and then served from the page cache. By default a batch is half the source's page
+        cache. Each destination's handler is called after each of its steps. */
+    int backup(std::vector<backup_target> const& targets, char const* dbname = "main", int step_page = 0);
+
+    /** Serializes a schema into a `database_image`. With `SQLITE_SERIALIZE_NOCOPY` the image
+        points into an in-memory database's own memory, and is empty for any other database. */
+    database_image serialize(char const* dbname = "main", unsigned flags = 0);
+    /** Replaces a schema with an in-memory database over the image. Images from `serialize()`
+        or `load()` are taken over, writable and growable; the schema frees them when closed.
+        A mapped or borrowed image is used in place, read-only, and must outlive the schema. */
+    int deserialize(database_image&& image, char const* dbname = "main");
+    int deserialize(database_image const& image, char const* dbname = "main");
 
     long long int last_insert_rowid() const;
 
@@ -184,6 +252,79 @@ namespace sqlite3pp
 
   enum copy_semantic { copy, nocopy };
 
+  template <class STMT> class statement_cache;
+
+  /** A named parameter key, e.g. `":id"`, whose hash is computed once, at compile time when
+      constructed from a string literal in a constant expression (see `literals::_param`). */
+  struct parameter
+  {
+    constexpr parameter(char const* name) : name(name), hash(hash_of(this->name)) {}
+    constexpr parameter(std::string_view name) : name(name), hash(hash_of(name)) {}
+
+    /// 32-bit FNV-1a
+    static constexpr uint32_t hash_of(std::string_view s) {
+      uint32_t h = 2166136261u;
+      for (char c : s)
+        h = (h ^ uint8_t(c)) * 16777619u;
+      return h;
+    }
+
+    std::string_view name;
+    uint32_t hash;
+  };
+
+  namespace literals
+  {
+    constexpr parameter operator""_param(char const* name, size_t n) {
+      return parameter(std::string_view(name, n));
+    }
+  }
+
+  /** Name to index table of the parameters of a prepared statement, built once from
+      `sqlite3_bind_parameter_name` so that binding by name costs a hash probe instead of
+      `sqlite3_bind_parameter_index`'s linear search. */
+  class parameter_table : noncopyable
+  {
+   public:
+    explicit parameter_table(sqlite3_stmt* stmt);
+
+    /// Returns the 1-based index of the parameter, or 0 if there is no such parameter.
+    int find(parameter key) const;
+
+   private:
+    struct slot {
+      uint32_t hash;
+      int idx;
+    };
+    std::vector<slot> slots_; // open addressing, size is a power of 2
+    std::vector<std::string> names_;
+  };
+
+  /** Idle prepared statements for one SQL text, owned by a `statement_cache`. A statement
+      checked out of it is returned, reset and unbound, when it's finished or destructed. */
+  class statement_pool : noncopyable
+  {
+   public:
+    statement_pool() = default;
+    ~statement_pool();
+
+    /// Returns an idle statement, or nullptr if all of them are checked out.
+    sqlite3_stmt* checkout();
+    void checkin(sqlite3_stmt* stmt);
+
+    size_t idle() const                     {return idle_.size();}
+    /// Memory used by the idle statements, as reported by SQLITE_STMTSTATUS_MEMUSED.
+    size_t memory_used() const              {return memory_;}
+
+    /// The parameter table shared by all statements of the pool, built from `stmt` on first use.
+    std::shared_ptr<parameter_table const> parameters(sqlite3_stmt* stmt);
+
+   private:
+    std::vector<sqlite3_stmt*> idle_;
+    size_t memory_ = 0;
+    std::shared_ptr<parameter_table const> parameters_;
+  };
+
   struct blob
   {
     const void* data;
@@ -191,8 +332,16 @@ namespace sqlite3pp
     copy_semantic fcopy;
   };
 
+  /// Binds a blob of `size` zero bytes, to be filled in later through a `blob_handle`.
+  struct zeroblob
+  {
+    uint64_t size;
+  };
+
   class statement : public checking, noncopyable
   {
+    template <class STMT> friend class statement_cache;
+
    public:
     int prepare(char const* stmt);
     int finish();
@@ -209,6 +358,7 @@ namespace sqlite3pp
     int bind(int idx, std::string_view value, copy_semantic fcopy = copy);
     int bind(int idx);
     int bind(int idx, null_type);
+    int bind(int idx, zeroblob value);
 
     int bind(char const* name, int value);
     int bind(char const* name, double value);
@@ -220,6 +370,19 @@ namespace sqlite3pp
     int bind(char const* name, std::string_view value, copy_semantic fcopy = copy);
     int bind(char const* name);
     int bind(char const* name, null_type);
+    int bind(char const* name, zeroblob value);
+
+    /// Binds by a precomputed key, e.g. `cmd.bind(":id"_param, 42)`.
+    template <class Key, class... Args,
+              class = std::enable_if_t<std::is_same<Key, parameter>::value>>
+    int bind(Key key, Args&&... args) {
+      return bind(parameter_index(key), std::forward<Args>(args)...);
+    }
+
+    /** Returns the 1-based index of a named parameter, or 0 if there is none. The name table
+        is built on first use and shared by all statements compiled by a `statement_cache`
+        for the same SQL. */
+    int parameter_index(parameter key);
 
     class bindref : noncopyable { // used by operator[]
     public:
@@ -237,8 +400,17 @@ namespace sqlite3pp
       int const idx_;
     };
 
+    /** Binds the members of a tuple-like value (`std::tuple`, `std::pair`, `std::array`) to
+        consecutive parameters starting at `idx`. Stops at the first error. */
+    template <class Tuple>
+    int bind_tuple(int idx, Tuple const& values, copy_semantic fcopy = copy) {
+      return bind_tuple_impl(idx, values, fcopy,
+                             std::make_index_sequence<std::tuple_size<Tuple>::value>());
+    }
+
     bindref operator[] (int idx)            {return bindref(*this, idx);}
     bindref operator[] (char const *name);
+    bindref operator[] (parameter key)      {return bindref(*this, parameter_index(key));}
 
     int step();
 
@@ -246,19 +418,39 @@ namespace sqlite3pp
     int reset();
     int unbind();
 
+    sqlite3_stmt* sqlite3_handle() const    {return stmt_;}
+
    protected:
     explicit statement(database& db, char const* stmt = nullptr);
-    statement(statement&&) = default;
+    statement(statement&&);
     ~statement();
 
     void share(const statement&);
     int prepare_impl(char const* stmt);
+
+    template <class T> int bind_value(int idx, T const& value, copy_semantic)         {return bind(idx, value);}
+    int bind_value(int idx, char const* value, copy_semantic fcopy)                   {return bind(idx, value, fcopy);}
+    int bind_value(int idx, std::string const& value, copy_semantic fcopy)            {return bind(idx, std::string_view(value), fcopy);}
+    int bind_value(int idx, std::string_view value, copy_semantic fcopy)              {return bind(idx, value, fcopy);}
+
+    template <class Tuple, size_t... Is>
+    int bind_tuple_impl([[maybe_unused]] int idx, [[maybe_unused]] Tuple const& values,
+                        [[maybe_unused]] copy_semantic fcopy, std::index_sequence<Is...>) {
+      int rc = SQLITE_OK;
+      (void)((rc = bind_value(idx + int(Is), std::get<Is>(values), fcopy), rc == SQLITE_OK) && ...);
+      return rc;
+    }
     int finish_impl(sqlite3_stmt* stmt);
 
+    /// Throws unless the statement has `count` parameters.
+    void check_parameters(int count) const;
+
    protected:
     sqlite3_stmt* stmt_;
     char const* tail_;
     bool shared_ = false;
+    std::shared_ptr<statement_pool> pool_;
+    std::shared_ptr<parameter_table const> parameters_;
   };
 
   class command : public statement
@@ -314,6 +506,195 @@ namespace sqlite3pp
 #if 0 // Disabled due to deprecation in SQLite 
     int execute_all();
 #endif
+
+    /** Executes the command once per element of `rows`, binding the members of each tuple-like
+        element (`std::tuple`, `std::pair`, `std::array`) to parameters 1..N. The rows are
+        inserted in `BEGIN IMMEDIATE` transactions that are committed every `rows_per_commit`
+        rows (0 for no limit) or every `commit_interval`, whichever comes first. If the database
+        is already in a transaction, the rows just become part of it.
+        On error, the current chunk is rolled back; chunks already committed stay committed. */
+    template <class Range>
+    int execute_batch(Range const& rows,
+                      size_t rows_per_commit = 1000,
+                      std::chrono::milliseconds commit_interval = std::chrono::milliseconds(500)) {
+      return execute_batch(rows, [](auto const& row) -> auto const& {return row;},
+                           rows_per_commit, commit_interval);
+    }
+
+    /** Like the above, but `project` maps each element to a tuple-like value to bind, e.g.
+        `[](contact const& c) {return std::tie(c.name, c.phone);}` for a struct. */
+    template <class Range, class Projection,
+              class = std::enable_if_t<std::is_invocable<Projection, decltype(*std::begin(std::declval<Range const&>()))>::value>>
+    int execute_batch(Range const& rows, Projection project,
+                      size_t rows_per_commit = 1000,
+                      std::chrono::milliseconds commit_interval = std::chrono::milliseconds(500));
+
+  };
+
+  /** Compile-time mapping of a C++ type to the `sqlite3_column_*` call that reads it,
+      used by `query::as()`. `numeric` types can't be read from TEXT or BLOB columns. */
+  template <class T> struct column_traits;
+
+  template <> struct column_traits<int> {
+    static constexpr bool numeric = true;
+    static int get(sqlite3_stmt* stmt, int idx)             {return sqlite3_column_int(stmt, idx);}
+  };
+  template <> struct column_traits<long int> {
+    static constexpr bool numeric = true;
+    static long int get(sqlite3_stmt* stmt, int idx)        {return long(sqlite3_column_int64(stmt, idx));}
+  };
+  template <> struct column_traits<long long int> {
+    static constexpr bool numeric = true;
+    static long long int get(sqlite3_stmt* stmt, int idx)   {return sqlite3_column_int64(stmt, idx);}
+  };
+  template <> struct column_traits<double> {
+    static constexpr bool numeric = true;
+    static double get(sqlite3_stmt* stmt, int idx)          {return sqlite3_column_double(stmt, idx);}
+  };
+  template <> struct column_traits<char const*> {
+    static constexpr bool numeric = false;
+    static char const* get(sqlite3_stmt* stmt, int idx) {
+      return reinterpret_cast<char const*>(sqlite3_column_text(stmt, idx));
+    }
+  };
+  template <> struct column_traits<std::string_view> {
+    static constexpr bool numeric = false;
+    static std::string_view get(sqlite3_stmt* stmt, int idx) {
+      auto text = reinterpret_cast<char const*>(sqlite3_column_text(stmt, idx));
+      if (!text)
+        return {};
+      return {text, size_t(sqlite3_column_bytes(stmt, idx))};
+    }
+  };
+  template <> struct column_traits<std::string> {
+    static constexpr bool numeric = false;
+    static std::string get(sqlite3_stmt* stmt, int idx) {
+      return std::string(column_traits<std::string_view>::get(stmt, idx));
+    }
+  };
+  template <> struct column_traits<void const*> {
+    static constexpr bool numeric = false;
+    static void const* get(sqlite3_stmt* stmt, int idx)     {return sqlite3_column_blob(stmt, idx);}
+  };
+  template <> struct column_traits<blob> {
+    static constexpr bool numeric = false;
+    static blob get(sqlite3_stmt* stmt, int idx) {
+      // Get the data first, so the size is that of the blob value, not of a conversion to text.
+      auto data = sqlite3_column_blob(stmt, idx);
+      return {data, size_t(sqlite3_column_bytes(stmt, idx)), copy};
+    }
+  };
+  template <> struct column_traits<null_type> {
+    static constexpr bool numeric = false;
+    static null_type get(sqlite3_stmt*, int)                {return ignore;}
+  };
+  template <class T> struct column_traits<std::optional<T>> {
+    static constexpr bool numeric = column_traits<T>::numeric;
+    static std::optional<T> get(sqlite3_stmt* stmt, int idx) {
+      if (sqlite3_column_type(stmt, idx) == SQLITE_NULL)
+        return std::nullopt;
+      return column_traits<T>::get(stmt, idx);
+    }
+  };
+
+  /** Compile-time mapping of a C++ type to the `sqlite3_bind_*` call that binds it, used by
+      `typed_command` and `typed_query`. `dtor` is `SQLITE_STATIC` or `SQLITE_TRANSIENT`. */
+  template <class T> struct parameter_traits;
+
+  template <> struct parameter_traits<int> {
+    static int bind(sqlite3_stmt* stmt, int idx, int value, sqlite3_destructor_type) {
+      return sqlite3_bind_int(stmt, idx, value);
+    }
+  };
+  template <> struct parameter_traits<long int> {
+    static int bind(sqlite3_stmt* stmt, int idx, long int value, sqlite3_destructor_type) {
+      return sqlite3_bind_int64(stmt, idx, value);
+    }
+  };
+  template <> struct parameter_traits<long long int> {
+    static int bind(sqlite3_stmt* stmt, int idx, long long int value, sqlite3_destructor_type) {
+      return sqlite3_bind_int64(stmt, idx, value);
+    }
+  };
+  template <> struct parameter_traits<double> {
+    static int bind(sqlite3_stmt* stmt, int idx, double value, sqlite3_destructor_type) {
+      return sqlite3_bind_double(stmt, idx, value);
+    }
+  };
+  template <> struct parameter_traits<std::string_view> {
+    static int bind(sqlite3_stmt* stmt, int idx, std::string_view value, sqlite3_destructor_type dtor) {
+      return sqlite3_bind_text(stmt, idx, value.data(), int(value.size()), dtor);
+    }
+  };
+  template <> struct parameter_traits<char const*> {
+    static int bind(sqlite3_stmt* stmt, int idx, char const* value, sqlite3_destructor_type dtor) {
+      return sqlite3_bind_text(stmt, idx, value, -1, dtor);
+    }
+  };
+  template <> struct parameter_traits<std::string> {
+    static int bind(sqlite3_stmt* stmt, int idx, std::string const& value, sqlite3_destructor_type dtor) {
+      return sqlite3_bind_text(stmt, idx, value.data(), int(value.size()), dtor);
+    }
+  };
+  template <> struct parameter_traits<blob> {
+    static int bind(sqlite3_stmt* stmt, int idx, blob value, sqlite3_destructor_type dtor) {
+      return sqlite3_bind_blob(stmt, idx, value.data, int(value.size), value.fcopy == copy ? SQLITE_TRANSIENT : dtor);
+    }
+  };
+  template <> struct parameter_traits<null_type> {
+    static int bind(sqlite3_stmt* stmt, int idx, null_type, sqlite3_destructor_type) {
+      return sqlite3_bind_null(stmt, idx);
+    }
+  };
+  template <> struct parameter_traits<zeroblob> {
+    static int bind(sqlite3_stmt* stmt, int idx, zeroblob value, sqlite3_destructor_type) {
+      return sqlite3_bind_zeroblob64(stmt, idx, value.size);
+    }
+  };
+  template <class T> struct parameter_traits<std::optional<T>> {
+    static int bind(sqlite3_stmt* stmt, int idx, std::optional<T> const& value, sqlite3_destructor_type dtor) {
+      if (!value)
+        return sqlite3_bind_null(stmt, idx);
+      return parameter_traits<T>::bind(stmt, idx, *value, dtor);
+    }
+  };
+
+  /** Query results in columnar form, filled by `query::fetch_columns()`: per column, one
+      contiguous array of values plus a null bitmap. Text and blob values are packed into a
+      per-column byte arena and addressed by offsets. Buffers keep their capacity when the
+      batch is refilled, so reusing a batch doesn't allocate once it has grown. */
+  class column_batch
+  {
+   public:
+    struct column
+    {
+      /// Storage kind: SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT or SQLITE_BLOB. Values of
+      /// other types are converted by SQLite; NULLs are stored as 0 or empty.
+      int type = SQLITE_NULL;
+      std::vector<long long int> integers;
+      std::vector<double> reals;
+      std::vector<size_t> offsets;      // row i is data[offsets[i], offsets[i+1])
+      std::string data;
+      std::vector<uint64_t> nulls;      // bit i set if row i is NULL
+
+      bool is_null(size_t row) const    {return (nulls[row / 64] >> (row % 64)) & 1;}
+      std::string_view bytes(size_t row) const {
+        return {data.data() + offsets[row], offsets[row + 1] - offsets[row]};
+      }
+    };
+
+    size_t size() const                 {return rows_;}
+    std::vector<column> const& columns() const  {return columns_;}
+    column const& operator[] (size_t idx) const {return columns_[idx];}
+
+    /// Forgets the column kinds too, so the batch can be used for another query.
+    void clear()                        {columns_.clear(); rows_ = 0;}
+
+   private:
+    friend class query;
+
+    std::vector<column> columns_;
+    size_t rows_ = 0;
   };
 
   class query : public statement
@@ -423,35 +804,249 @@ namespace sqlite3pp
 
     iterator begin();
     iterator end();
+
+    /** Steps through up to `max_rows` rows, replacing the contents of `batch` with them, and
+        returns the number of rows fetched. Fewer than `max_rows` means the query is done;
+        calling it again after that restarts the query. Column kinds are chosen on the first
+        fetch into a batch, from the declared type or else from the first row's values. */
+    size_t fetch_columns(column_batch& batch, size_t max_rows);
+
+    /// A range over the result rows, each read as a `Row` built from columns of types `Ts`.
+    template <class Row, class... Ts> class typed_rows;
+
+    /** Iterates the results as `std::tuple<Ts...>`, e.g.
+        `for (auto [id, name] : qry.as<long long, std::string_view>())`.
+        The column count, and the column types as far as the declared types tell, are
+        checked once before the first step. */
+    template <class... Ts>
+    typed_rows<std::tuple<Ts...>, Ts...> as()         {return typed_rows<std::tuple<Ts...>, Ts...>(*this);}
+
+    /// Like `as()`, but each row is a `Struct` brace-initialized from the columns in order.
+    template <class Struct, class... Ts>
+    typed_rows<Struct, Ts...> as_struct()             {return typed_rows<Struct, Ts...>(*this);}
+
+   protected:
+    /// Throws unless there are `numeric.size()` columns and no numeric one is declared TEXT or BLOB.
+    void check_columns(std::initializer_list<bool> numeric) const;
+  };
+
+  template <class Row, class... Ts>
+  class query::typed_rows
+  {
+   public:
+    class iterator
+    {
+     public:
+      typedef Row       value_type;
+      typedef ptrdiff_t difference_type;
+      typedef Row*      pointer;
+      typedef Row       reference;
+      typedef std::input_iterator_tag iterator_category;
+
+      iterator() : qry_(nullptr), rc_(SQLITE_DONE) {}
+      explicit iterator(query* qry) : qry_(qry)   {next();}
+
+      bool operator==(iterator const& other) const  {return rc_ == other.rc_;}
+      bool operator!=(iterator const& other) const  {return rc_ != other.rc_;}
+
+      iterator& operator++()                      {next(); return *this;}
+
+      Row operator*() const {
+        return row(std::index_sequence_for<Ts...>());
+      }
+
+     private:
+      void next() {
+        rc_ = qry_->step();
+        if (rc_ != SQLITE_ROW && rc_ != SQLITE_DONE)
+          qry_->throw_(rc_);
+      }
+
+      template <size_t... Is>
+      Row row(std::index_sequence<Is...>) const {
+        // Braced initialization evaluates the columns in order.
+        return Row{column_traits<Ts>::get(qry_->stmt_, int(Is))...};
+      }
+
+      query* qry_;
+      int rc_;
+    };
+
+    /// `checked` skips the column check, for a `typed_query` that did it when prepared.
+    explicit typed_rows(query& qry, bool checked = false) : qry_(qry), checked_(checked) {}
+
+    iterator begin() {
+      if (!checked_)
+        qry_.check_columns({column_traits<Ts>::numeric...});
+      return iterator(&qry_);
+    }
+    iterator end()                                {return iterator();}
+
+   private:
+    query& qry_;
+    bool checked_;
+  };
+
+  /** A command with a fixed parameter signature, e.g.
+      `typed_command<long long, std::string_view> cmd(db, "INSERT INTO t VALUES (?, ?)")`.
+      The parameter count is checked once when the statement is prepared; `execute()` then
+      binds every parameter with a direct `sqlite3_bind_*` call, steps and resets.
+      Text and blobs are bound without copying, so they only need to live until `execute()`
+      returns. */
+  template <class... Args>
+  class typed_command : public command
+  {
+   public:
+    typed_command(database& db, char const* stmt) : command(db, stmt) {
+      check_parameters(sizeof...(Args));
+    }
+
+    int execute(Args const&... args) {
+      auto rc = bind_all(std::index_sequence_for<Args...>(), args...);
+      if (rc == SQLITE_OK) {
+        rc = sqlite3_step(stmt_);
+        sqlite3_reset(stmt_);
+        if (rc == SQLITE_DONE) rc = SQLITE_OK;
+      }
+      return check(rc);
+    }
+
+   private:
+    template <size_t... Is>
+    int bind_all(std::index_sequence<Is...>, [[maybe_unused]] Args const&... args) {
+      int rc = SQLITE_OK;
+      (void)((rc = parameter_traits<Args>::bind(stmt_, int(Is) + 1, args, SQLITE_STATIC), rc == SQLITE_OK) && ...);
+      return rc;
+    }
+  };
+
+  template <class Params, class Columns> class typed_query;
+
+  /** A query with fixed parameter and column signatures, e.g.
+      `typed_query<std::tuple<long long>, std::tuple<std::string_view, double>>`.
+      The parameter and column counts, and the column types as far as the declared types tell,
+      are checked once when the statement is prepared. Calling it binds the parameters with
+      direct `sqlite3_bind_*` calls and returns the result rows as `std::tuple<Cols...>`:
+      `for (auto [name, score] : qry(42))`. Text and blob parameters are copied, since
+      arguments are often temporaries destroyed before the rows are read. */
+  template <class... Params, class... Cols>
+  class typed_query<std::tuple<Params...>, std::tuple<Cols...>> : public query
+  {
+   public:
+    using rows_type = typed_rows<std::tuple<Cols...>, Cols...>;
+
+    typed_query(database& db, char const* stmt) : query(db, stmt) {
+      check_parameters(sizeof...(Params));
+      check_columns({column_traits<Cols>::numeric...});
+    }
+
+    rows_type operator()(Params const&... params) {
+      sqlite3_reset(stmt_);
+      auto rc = bind_all(std::index_sequence_for<Params...>(), params...);
+      if (rc != SQLITE_OK)
+        throw_(rc);
+      return rows_type(*this, true);
+    }
+
+   private:
+    template <size_t... Is>
+    int bind_all(std::index_sequence<Is...>, [[maybe_unused]] Params const&... params) {
+      int rc = SQLITE_OK;
+      (void)((rc = parameter_traits<Params>::bind(stmt_, int(Is) + 1, params, SQLITE_TRANSIENT), rc == SQLITE_OK) && ...);
+      return rc;
+    }
   };
 
-  /** A cache of pre-compiled `query` or `command` objects. */
+  /** A cache of pre-compiled `query` or `command` objects, bounded by entry count and by the
+      memory SQLite reports for the idle prepared statements. The least recently used entries
+      are evicted first. Lookups by `std::string_view` don't allocate.
+      Each returned object has exclusive use of its prepared statement, which goes back to the
+      cache when the object is destructed; another statement is only prepared for the same SQL
+      while the first one is still in use, so nested or recursive use is safe. */
   template <class STMT>
   class statement_cache {
   public:
-    explicit statement_cache(database &db) :db_(db) { }
+    struct counters {
+      size_t hits = 0;          // served by an idle prepared statement
+      size_t misses = 0;        // had to prepare a statement
+      size_t evictions = 0;
+    };
 
-    STMT compile(const std::string &sql) {
-      const STMT* stmt;
-      if (auto i = stmts_.find(sql); i != stmts_.end()) {
-        stmt = &i->second;
+    /// `max_memory` is in bytes; 0 means no memory limit.
+    explicit statement_cache(database &db, size_t max_entries = 100, size_t max_memory = 0)
+    :db_(db), max_entries_(max_entries), max_memory_(max_memory) { }
+
+    STMT compile(std::string_view sql) {
+      STMT stmt(db_);
+      auto i = index_.find(sql);
+      if (i != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, i->second);
+        if (auto s = lru_.front().pool->checkout()) {
+          ++counters_.hits;
+          stmt.stmt_ = s;
+          stmt.pool_ = lru_.front().pool;
+          return stmt;
+        }
       } else {
-        auto x = stmts_.emplace(std::piecewise_construct,
-                                std::tuple<std::string>{sql},
-                                std::tuple<database&,const char*>{db_, sql.c_str()});
-        stmt = &x.first->second;
+        lru_.emplace_front(sql);
+        index_.emplace(lru_.front().sql, lru_.begin());
+      }
+      ++counters_.misses;
+      entry& e = lru_.front();
+      auto rc = stmt.prepare_impl(e.sql.c_str());
+      if (rc != SQLITE_OK) {
+        if (e.pool->idle() == 0 && e.pool.use_count() == 1) {
+          index_.erase(e.sql);
+          lru_.pop_front();
+        }
+        throw database_error(db_, rc);
       }
-      return stmt->shared_copy();
+      stmt.pool_ = e.pool;
+      evict();
+      return stmt;
     }
 
-    STMT operator[] (const std::string &sql)    {return compile(sql);}
-    STMT operator[] (const char *sql)           {return compile(sql);}
+    STMT operator[] (std::string_view sql)      {return compile(sql);}
+
+    void clear()                                {index_.clear(); lru_.clear();}
+
+    size_t size() const                         {return lru_.size();}
+    const counters& stats() const               {return counters_;}
 
-    void clear()                                {stmts_.clear();}
+    size_t memory_used() const {
+      size_t total = 0;
+      for (auto& e : lru_)
+        total += e.pool->memory_used();
+      return total;
+    }
 
   private:
+    struct entry {
+      explicit entry(std::string_view s) :sql(s), pool(std::make_shared<statement_pool>()) { }
+
+      std::string const sql;
+      std::shared_ptr<statement_pool> const pool;
+    };
+
+    void evict() {
+      // Statements still checked out of an evicted entry are finalized when they're done.
+      // The front entry, which the caller is using, is never evicted.
+      auto memory = max_memory_ ? memory_used() : 0;
+      while (lru_.size() > 1 && (lru_.size() > max_entries_ || memory > max_memory_)) {
+        auto& victim = lru_.back();
+        memory -= victim.pool->memory_used();
+        index_.erase(victim.sql);
+        lru_.pop_back();
+        ++counters_.evictions;
+      }
+    }
+
     database& db_;
-    std::unordered_map<std::string,STMT> stmts_;
+    size_t const max_entries_;
+    size_t const max_memory_;
+    counters counters_;
+    std::list<entry> lru_;      // most recently used first
+    std::unordered_map<std::string_view, typename std::list<entry>::iterator> index_;
   };
 
   using command_cache = statement_cache<command>;
@@ -489,7 +1084,128 @@ namespace sqlite3pp
     bool fcommit_;
   };
 
-  /** Random access to the data in a blob. */
+  template <class Range, class Projection, class>
+  int command::execute_batch(Range const& rows, Projection project,
+                             size_t rows_per_commit, std::chrono::milliseconds commit_interval) {
+    using clock = std::chrono::steady_clock;
+    bool const own_transaction = sqlite3_get_autocommit(db_.sqlite3_handle());
+    if (rows_per_commit == 0)
+      rows_per_commit = std::numeric_limits<size_t>::max();
+    // On every way out, including exceptions, don't leave parameters pointing into the
+    // caller's rows.
+    struct cleanup {
+      command& cmd;
+      ~cleanup() {
+        cmd.reset();
+        sqlite3_clear_bindings(cmd.sqlite3_handle());
+      }
+    } const guard{*this};
+    auto i = std::begin(rows);
+    auto const e = std::end(rows);
+    while (i != e) {
+      std::unique_ptr<transaction> xct;
+      if (own_transaction)
+        xct = std::make_unique<transaction>(db_, false, true);
+      auto const deadline = clock::now() + commit_interval;
+      for (size_t n = 0; i != e && (!own_transaction || n < rows_per_commit); ++i, ++n) {
+        // Values are bound without copying: the projected row, even a temporary, is kept
+        // until the row has been stepped.
+        auto&& row = project(*i);
+        auto rc = bind_tuple(1, row, nocopy);
+        if (rc == SQLITE_OK)
+          rc = execute();
+        reset();
+        if (rc != SQLITE_OK)
+          return rc;
+        if (own_transaction && clock::now() >= deadline) {
+          ++i;
+          break;
+        }
+      }
+      if (xct) {
+        auto rc = xct->commit();
+        if (rc != SQLITE_OK)
+          return rc;
+      }
+    }
+    return SQLITE_OK;
+  }
+
+  /** Inserts rows into one table using multi-row `INSERT ... VALUES (?,?),(?,?),...` statements,
+      so each statement execution inserts a whole block of rows. Blocks are as large as
+      `max_block_rows` and SQLITE_LIMIT_VARIABLE_NUMBER allow; a shorter tail is inserted with
+      blocks of repeatedly halved size (e.g. 100, 50, 25, 12, 6, 3, 1), so at most log2(block
+      size) extra statements are ever prepared.
+      The statements are kept in a `command_cache`. */
+  class bulk_loader : noncopyable
+  {
+   public:
+    /// `table` and `columns` are inserted into the SQL as given; `verb` may be e.g. "INSERT OR REPLACE".
+    bulk_loader(database& db, std::string table, std::vector<std::string> columns,
+                size_t max_block_rows = 256, char const* verb = "INSERT");
+
+    /// Number of rows inserted by each execution of the largest statement.
+    size_t block_rows() const                 {return block_rows_;}
+
+    /** Inserts every tuple-like element of `rows`, whose members are bound to the columns in
+        order. Runs in a `BEGIN IMMEDIATE` transaction unless one is already open. */
+    template <class Range>
+    int insert(Range const& rows) {
+      return insert(rows, [](auto const& row) -> auto const& {return row;});
+    }
+
+    /// Like the above, but `project` maps each element to the tuple-like value to insert.
+    template <class Range, class Projection>
+    int insert(Range const& rows, Projection project);
+
+   private:
+    std::string const& sql(size_t nrows);
+
+    database& db_;
+    std::string const table_;
+    std::vector<std::string> const columns_;
+    std::string const verb_;
+    size_t block_rows_;
+    std::map<size_t, std::string> sql_;     // by rows per statement
+    command_cache cache_;
+  };
+
+  template <class Range, class Projection>
+  int bulk_loader::insert(Range const& rows, Projection project) {
+    std::unique_ptr<transaction> xct;
+    if (sqlite3_get_autocommit(db_.sqlite3_handle()))
+      xct = std::make_unique<transaction>(db_, false, true);
+
+    int const ncols = int(columns_.size());
+    auto i = std::begin(rows);
+    auto const e = std::end(rows);
+    size_t remaining = size_t(std::distance(i, e));
+    size_t nrows = block_rows_;
+    while (remaining > 0) {
+      while (nrows > remaining)
+        nrows /= 2;
+      auto cmd = cache_.compile(sql(nrows));
+      for (; remaining >= nrows; remaining -= nrows) {
+        int idx = 1;
+        for (size_t r = 0; r < nrows; ++r, ++i, idx += ncols) {
+          // Values in the caller's rows outlive the execution and needn't be copied; a
+          // projection returning a temporary is gone by then.
+          constexpr bool temporary = !std::is_reference_v<decltype(project(*i))>;
+          auto rc = cmd.bind_tuple(idx, project(*i), temporary ? copy : nocopy);
+          if (rc != SQLITE_OK)
+            return rc;
+        }
+        auto rc = cmd.execute();
+        cmd.reset();
+        if (rc != SQLITE_OK)
+          return rc;
+      }
+    }
+    return xct ? xct->commit() : SQLITE_OK;
+  }
+
+  /** Random access to the data in a blob. A blob can't be resized through the handle; insert
+      a `zeroblob` of the final size first and then write its contents. */
   class blob_handle : public noncopyable {
   public:
     blob_handle(database& db,
@@ -499,12 +1215,49 @@ namespace sqlite3pp
     ~blob_handle()                      {if (blob_) sqlite3_blob_close(blob_);}
     uint64_t size() const               {return size_;}
     int64_t read(void *dst, size_t len, uint64_t offset);
+    /// Returns the number of bytes written, which stops at the end of the blob, or -1.
+    int64_t write(void const* src, size_t len, uint64_t offset);
+
+    /** Points the handle at the same column of another row, which is much cheaper than
+        opening a new handle. Throws if there is no such row or it's not a blob; the handle
+        can't be used again until a later `reopen()` succeeds. */
+    void reopen(int64_t rowid);
 
   private:
+    database&       db_;
     sqlite3_blob*   blob_ = nullptr;
     uint64_t        size_;
   };
 
+  /** A `std::streambuf` over a `blob_handle`, so a blob can be read or written with iostreams
+      in `buffer_size` chunks instead of being copied whole. Reads and writes of at least
+      `buffer_size` bytes go straight between the blob and the caller's memory.
+      Writing can't go past the end of the blob. */
+  class blob_streambuf : public std::streambuf
+  {
+   public:
+    explicit blob_streambuf(blob_handle& blob, size_t buffer_size = 64 * 1024);
+    ~blob_streambuf() override;
+
+   protected:
+    int_type underflow() override;
+    int_type overflow(int_type ch) override;
+    int sync() override;
+    std::streamsize xsgetn(char* s, std::streamsize n) override;
+    std::streamsize xsputn(char const* s, std::streamsize n) override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+   private:
+    uint64_t position() const;
+    /// Writes out pending output and empties the buffer, leaving `offset_` at the current position.
+    bool flush();
+
+    blob_handle& blob_;
+    std::vector<char> buffer_;
+    uint64_t offset_ = 0; // blob offset of the start of the buffer
+  };
+
 } // namespace sqlite3pp
 
 #endif
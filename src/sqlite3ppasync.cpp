@@ -0,0 +1,117 @@
+// sqlite3ppasync.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <cstdint>
+
+#include "sqlite3ppasync.h"
+
+#ifdef __linux__
+#  include <sys/eventfd.h>
+#  include <unistd.h>
+#endif
+
+namespace sqlite3pp
+{
+
+  async_executor::async_executor(connection_pool& pool, size_t threads) : pool_(pool)
+  {
+#ifdef __linux__
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd_ < 0)
+      throw database_error("can't create eventfd", SQLITE_ERROR);
+#endif
+    for (size_t i = 0; i < threads; ++i)
+      threads_.emplace_back([this] { work(); });
+  }
+
+  async_executor::~async_executor()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cond_.notify_all();
+    for (auto& t : threads_)
+      t.join();
+#ifdef __linux__
+    close(event_fd_);
+#endif
+  }
+
+  void async_executor::post(task t)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(t));
+    }
+    cond_.notify_one();
+  }
+
+  void async_executor::work()
+  {
+    for (;;) {
+      task t;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+        if (tasks_.empty())
+          return;
+        t = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      t(pool_);
+    }
+  }
+
+  void async_executor::complete(std::function<void ()> continuation)
+  {
+    {
+      std::lock_guard<std::mutex> lock(completions_mutex_);
+      completions_.push_back(std::move(continuation));
+    }
+#ifdef __linux__
+    uint64_t one = 1;
+    // Can only fail if the counter would overflow, in which case it's readable anyway.
+    (void)!write(event_fd_, &one, sizeof(one));
+#endif
+  }
+
+  size_t async_executor::run_completions()
+  {
+#ifdef __linux__
+    uint64_t count;
+    (void)!read(event_fd_, &count, sizeof(count));
+#endif
+    std::vector<std::function<void ()>> completions;
+    {
+      std::lock_guard<std::mutex> lock(completions_mutex_);
+      completions.swap(completions_);
+    }
+    for (auto& c : completions)
+      c();
+    return completions.size();
+  }
+
+} // namespace sqlite3pp
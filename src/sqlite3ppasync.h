@@ -0,0 +1,252 @@
+// sqlite3ppasync.h
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3PPASYNC_H
+#define SQLITE3PPASYNC_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#  include <coroutine>
+#  define SQLITE3PP_COROUTINES 1
+#endif
+
+#include "sqlite3pp.h"
+#include "sqlite3pppool.h"
+
+namespace sqlite3pp
+{
+  class async_executor;
+
+  /** The eventual result of a task run by an `async_executor`. `get()` blocks until it's
+      ready and can be called once; `then()` registers a callback that
+      `async_executor::run_completions()` calls on the event loop thread. With C++20
+      coroutines it can also be `co_await`ed, resuming the coroutine from `run_completions()`.
+      Completions are only queued for results with a callback or coroutine waiting, so a
+      caller that only uses `get()` needn't run completions at all. */
+  template <class T>
+  class async_result
+  {
+   public:
+    bool ready() const {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      return state_->ready;
+    }
+
+    /// Waits for the result; rethrows the task's exception, if any.
+    T get() {
+      std::unique_lock<std::mutex> lock(state_->mutex);
+      state_->cond.wait(lock, [this] { return state_->ready; });
+      if (state_->retrieved)
+        throw database_error("async_result: the result was already retrieved", SQLITE_MISUSE);
+      state_->retrieved = true;
+      if (state_->error)
+        std::rethrow_exception(state_->error);
+      if constexpr (!std::is_void_v<T>)
+        return std::move(*state_->value);
+    }
+
+    /// Must be called on the thread that calls `run_completions()`. If the result is
+    /// ready already, f is called right away.
+    void then(std::function<void ()> f) {
+      {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (!state_->ready) {
+          state_->continuation = std::move(f);
+          return;
+        }
+      }
+      f();
+    }
+
+#ifdef SQLITE3PP_COROUTINES
+    bool await_ready() const                  {return ready();}
+    bool await_suspend(std::coroutine_handle<> h) {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      if (state_->ready)
+        return false;
+      state_->continuation = [h] { h.resume(); };
+      return true;
+    }
+    T await_resume()                          {return get();}
+#endif
+
+   private:
+    friend class async_executor;
+
+    using value_type = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+    struct state
+    {
+      std::mutex mutex;
+      std::condition_variable cond;
+      bool ready = false;
+      bool retrieved = false;
+      std::optional<value_type> value;
+      std::exception_ptr error;
+      std::function<void ()> continuation;    // queued for run_completions() when ready
+    };
+
+    async_result() : state_(std::make_shared<state>()) {}
+
+    std::shared_ptr<state> state_;
+  };
+
+  namespace
+  {
+    /// How a statement parameter passed to an async_executor is kept until a worker binds
+    /// it: pointers and views to text are copied, since the caller's buffer may be gone.
+    template <class T> struct async_parameter                 {using type = T;};
+    template <> struct async_parameter<char const*>           {using type = std::string;};
+    template <> struct async_parameter<char*>                 {using type = std::string;};
+    template <> struct async_parameter<std::string_view>      {using type = std::string;};
+  }
+
+  /** Runs statements on worker threads, each leasing a connection from a `connection_pool`
+      for the duration of one task, so an event loop thread never blocks on SQLite.
+      Completions are signalled through `completion_fd()` (an eventfd on Linux), which an
+      epoll/poll loop can wait on before calling `run_completions()`. */
+  class async_executor : noncopyable
+  {
+   public:
+    async_executor(connection_pool& pool, size_t threads);
+    /// Finishes the queued tasks, then stops the worker threads.
+    ~async_executor();
+
+    /// Readable when completions are pending; -1 if the platform has no eventfd.
+    int completion_fd() const                 {return event_fd_;}
+
+    /// Calls the `then()` callbacks (and resumes coroutines) of finished tasks.
+    /// Returns the number of completions delivered.
+    size_t run_completions();
+
+    /** Runs `f(database&)` on a worker thread, with the writer connection if `write` is set or
+        else a read-only one, and returns its eventual result. */
+    template <class F>
+    auto submit(bool write, F f) -> async_result<decltype(f(std::declval<database&>()))>;
+
+    /** Runs a query with the given parameters and collects its rows as tuples. The column
+        types must own their data, since the rows outlive the statement. */
+    template <class... Ts, class... Args>
+    async_result<std::vector<std::tuple<Ts...>>> query(std::string sql, Args... args) {
+      static_assert(((!std::is_same<Ts, std::string_view>::value && !std::is_same<Ts, char const*>::value) && ...),
+                    "use std::string for text columns");
+      return submit(false, [sql = std::move(sql),
+                            params = std::make_tuple(typename async_parameter<Args>::type(std::move(args))...)](database& db) {
+        sqlite3pp::query qry(db, sql.c_str());
+        qry.exceptions(true);
+        qry.bind_tuple(1, params, nocopy);
+        std::vector<std::tuple<Ts...>> rows;
+        for (auto row : qry.template as<Ts...>())
+          rows.push_back(std::move(row));
+        return rows;
+      });
+    }
+
+    /// Executes a command with the given parameters on the writer connection; the result is
+    /// the number of rows changed.
+    template <class... Args>
+    async_result<int> execute(std::string sql, Args... args) {
+      return submit(true, [sql = std::move(sql),
+                           params = std::make_tuple(typename async_parameter<Args>::type(std::move(args))...)](database& db) {
+        command cmd(db, sql.c_str());
+        cmd.exceptions(true);
+        cmd.bind_tuple(1, params, nocopy);
+        cmd.execute();
+        return db.changes();
+      });
+    }
+
+   private:
+    using task = std::function<void (connection_pool&)>;   // called on a worker thread
+
+    void post(task t);
+    void work();
+    void complete(std::function<void ()> continuation);
+
+    connection_pool& pool_;
+    int event_fd_ = -1;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<task> tasks_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+
+    std::mutex completions_mutex_;
+    std::vector<std::function<void ()>> completions_;
+  };
+
+  template <class F>
+  auto async_executor::submit(bool write, F f) -> async_result<decltype(f(std::declval<database&>()))> {
+    using R = decltype(f(std::declval<database&>()));
+    async_result<R> result;
+    auto state = result.state_;
+    post([this, state, write, f = std::move(f)](connection_pool& pool) mutable {
+      std::optional<typename async_result<R>::value_type> value;
+      std::exception_ptr error;
+      try {
+        auto lease = write ? pool.writer() : pool.reader();
+        if constexpr (std::is_void_v<R>) {
+          f(*lease);
+          value.emplace();
+        }
+        else {
+          value.emplace(f(*lease));
+        }
+      } catch (...) {
+        error = std::current_exception();
+      }
+      std::function<void ()> continuation;
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->value = std::move(value);
+        state->error = error;
+        state->ready = true;
+        continuation = std::move(state->continuation);
+        state->cond.notify_all();
+      }
+      if (continuation)
+        complete(std::move(continuation));
+    });
+    return result;
+  }
+
+} // namespace sqlite3pp
+
+#endif
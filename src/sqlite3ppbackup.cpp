@@ -0,0 +1,338 @@
+// sqlite3ppbackup.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3ppbackup.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+namespace sqlite3pp
+{
+
+  backup_job::backup_job(database& source, database& dest, options opts)
+    : backup_job(source, dest, opts, "main", "main")
+  {
+  }
+
+  backup_job::backup_job(database& source, database& dest, options opts,
+                         char const* sourcename, char const* destname)
+    : opts_(opts)
+  {
+    backup_ = sqlite3_backup_init(dest.sqlite3_handle(), destname, source.sqlite3_handle(), sourcename);
+    if (!backup_)
+      throw database_error(dest, dest.error_code());
+    progress_.step_pages = std::max(opts_.initial_pages, 1);
+    thread_ = std::thread([this] {run();});
+  }
+
+  backup_job::~backup_job()
+  {
+    cancel();
+    wait();
+  }
+
+  backup_job::progress backup_job::status() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return progress_;
+  }
+
+  void backup_job::cancel()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cancelled_ = true;
+    cancel_cond_.notify_all();
+  }
+
+  int backup_job::wait()
+  {
+    if (thread_.joinable())
+      thread_.join();
+    return progress_.rc;
+  }
+
+  bool backup_job::sleep(std::chrono::milliseconds d)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return !cancel_cond_.wait_for(lock, d, [this] {return cancelled_;});
+  }
+
+  void backup_job::run()
+  {
+    using clock = std::chrono::steady_clock;
+    auto const start = clock::now();
+    auto const budget_ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(opts_.step_budget).count());
+    int pages = progress_.step_pages;
+    int remaining = -1;
+    double copied = 0;
+    double ns_per_page = 0;
+    int rc;
+    for (;;) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cancelled_) {
+          rc = SQLITE_INTERRUPT;
+          break;
+        }
+      }
+      auto t0 = clock::now();
+      rc = sqlite3_backup_step(backup_, pages);
+      auto elapsed_ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t0).count());
+
+      if (rc == SQLITE_OK || rc == SQLITE_DONE) {
+        int now_remaining = sqlite3_backup_remaining(backup_);
+        int stepped = remaining < 0 ? sqlite3_backup_pagecount(backup_) - now_remaining : remaining - now_remaining;
+        remaining = now_remaining;
+        copied += std::max(stepped, 0);
+        // A smoothed cost per page sizes the next step to the budget.
+        if (stepped > 0) {
+          auto cost = elapsed_ns / stepped;
+          ns_per_page = ns_per_page > 0 ? 0.75 * ns_per_page + 0.25 * cost : cost;
+          pages = int(std::clamp(budget_ns / ns_per_page, 1.0, double(std::max(opts_.max_pages, 1))));
+        }
+      } else if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+        pages = std::max(pages / 2, 1);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        progress_.remaining = sqlite3_backup_remaining(backup_);
+        progress_.pagecount = sqlite3_backup_pagecount(backup_);
+        progress_.step_pages = pages;
+        std::chrono::duration<double> total = clock::now() - start;
+        progress_.pages_per_second = total.count() > 0 ? copied / total.count() : 0;
+      }
+
+      if (rc == SQLITE_OK) {
+        if (!sleep(opts_.pause))
+          continue; // reports the cancellation
+      } else if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+        if (!sleep(opts_.busy_backoff))
+          continue;
+      } else {
+        break;
+      }
+    }
+
+    auto finish_rc = sqlite3_backup_finish(backup_);
+    if (rc == SQLITE_DONE)
+      rc = finish_rc;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    progress_.rc = rc;
+    progress_.done = true;
+  }
+
+  namespace
+  {
+    char const manifest_magic[] = "sqlite3pp manifest 1\n";
+
+    uint64_t page_checksum(unsigned char const* data, size_t n)
+    {
+      uint64_t h = 0x9e3779b97f4a7c15ull ^ n;
+      size_t i = 0;
+      for (; i + 8 <= n; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        h = (h ^ word) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+      }
+      for (; i < n; ++i)
+        h = (h ^ data[i]) * 0x100000001b3ull;
+      return h;
+    }
+
+    /// A file opened through the default VFS, so that writes can be synced portably.
+    class vfs_file : noncopyable
+    {
+     public:
+      explicit vfs_file(std::string const& path)
+        : vfs_(sqlite3_vfs_find(nullptr)), file_(static_cast<sqlite3_file*>(sqlite3_malloc(vfs_->szOsFile))),
+          name_(sqlite3_create_filename(path.c_str(), "", "", 0, nullptr))
+      {
+        if (!file_ || !name_) {
+          sqlite3_free(file_);
+          sqlite3_free_filename(name_);
+          throw database_error("out of memory", SQLITE_NOMEM);
+        }
+        std::memset(file_, 0, vfs_->szOsFile);
+        int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_MAIN_DB;
+        int rc = vfs_->xOpen(vfs_, name_, file_, flags, &flags);
+        if (rc != SQLITE_OK) {
+          if (file_->pMethods)
+            file_->pMethods->xClose(file_);
+          sqlite3_free(file_);
+          sqlite3_free_filename(name_);
+          throw database_error(("cannot open " + path).c_str(), rc);
+        }
+      }
+
+      ~vfs_file()
+      {
+        file_->pMethods->xClose(file_);
+        sqlite3_free(file_);
+        sqlite3_free_filename(name_);
+      }
+
+      int64_t size()
+      {
+        sqlite3_int64 n = 0;
+        check(file_->pMethods->xFileSize(file_, &n));
+        return n;
+      }
+
+      void write(void const* data, int n, int64_t offset)    {check(file_->pMethods->xWrite(file_, data, n, offset));}
+      void truncate(int64_t n)                                {check(file_->pMethods->xTruncate(file_, n));}
+      void sync()                                             {check(file_->pMethods->xSync(file_, SQLITE_SYNC_NORMAL));}
+
+     private:
+      static void check(int rc) {
+        if (rc != SQLITE_OK)
+          throw database_error("incremental backup: cannot write the destination", rc);
+      }
+
+      sqlite3_vfs* vfs_;
+      sqlite3_file* file_;
+      sqlite3_filename name_;
+    };
+  }
+
+  incremental_backup::incremental_backup(database& source, std::string destpath, std::string manifestpath,
+                                         char const* sourcename)
+    : source_(source), destpath_(std::move(destpath)),
+      manifestpath_(manifestpath.empty() ? destpath_ + ".manifest" : std::move(manifestpath)),
+      sourcename_(sourcename)
+  {
+  }
+
+  std::vector<uint64_t> incremental_backup::load_manifest(int page_size) const
+  {
+    std::vector<uint64_t> checksums;
+    std::ifstream in(manifestpath_, std::ios::binary);
+    char magic[sizeof(manifest_magic) - 1];
+    int32_t size;
+    uint64_t count;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, manifest_magic, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(&size), sizeof(size)) || size != page_size ||
+        !in.read(reinterpret_cast<char*>(&count), sizeof(count)))
+      return checksums;
+    checksums.resize(count);
+    if (!in.read(reinterpret_cast<char*>(checksums.data()), std::streamsize(count * sizeof(uint64_t))))
+      checksums.clear();
+    return checksums;
+  }
+
+  void incremental_backup::save_manifest(int page_size, std::vector<uint64_t> const& checksums) const
+  {
+    auto tmp = manifestpath_ + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      int32_t size = page_size;
+      uint64_t count = checksums.size();
+      out.write(manifest_magic, sizeof(manifest_magic) - 1);
+      out.write(reinterpret_cast<char const*>(&size), sizeof(size));
+      out.write(reinterpret_cast<char const*>(&count), sizeof(count));
+      out.write(reinterpret_cast<char const*>(checksums.data()), std::streamsize(count * sizeof(uint64_t)));
+      if (!out.flush())
+        throw database_error("incremental backup: cannot write the manifest", SQLITE_IOERR);
+    }
+    if (std::rename(tmp.c_str(), manifestpath_.c_str()) != 0)
+      throw database_error("incremental backup: cannot write the manifest", SQLITE_IOERR);
+  }
+
+  incremental_backup::result incremental_backup::run()
+  {
+    auto pragma = [this](char const* name) {
+      query qry(source_, ("PRAGMA \"" + sourcename_ + "\"." + name).c_str());
+      auto i = qry.begin();
+      return i == qry.end() ? std::string() : std::string((*i).get<char const*>(0));
+    };
+
+    // One read transaction for a consistent snapshot of all pages.
+    transaction xct(source_);
+    int const page_size = std::stoi(pragma("page_size"));
+    uint64_t const page_count = std::stoull(pragma("page_count"));
+
+    std::unique_ptr<query> dbpage;
+    sqlite3_file* file = nullptr;
+    try {
+      dbpage = std::make_unique<query>(source_, "SELECT pgno, data FROM sqlite_dbpage(?)");
+      dbpage->bind(1, sourcename_, copy);
+    }
+    catch (database_error&) {
+      dbpage.reset();
+      if (pragma("journal_mode") == "wal")
+        throw database_error("incremental backup of a WAL database needs sqlite_dbpage", SQLITE_ERROR);
+      sqlite3_file_control(source_.sqlite3_handle(), sourcename_.c_str(), SQLITE_FCNTL_FILE_POINTER, &file);
+      if (!file || !file->pMethods)
+        throw database_error("incremental backup: cannot read the source database", SQLITE_ERROR);
+    }
+
+    vfs_file dest(destpath_);
+    auto previous = load_manifest(page_size);
+    if (uint64_t(dest.size()) != previous.size() * page_size)
+      previous.clear();
+    std::remove(manifestpath_.c_str());
+
+    result res;
+    res.pages = page_count;
+    std::vector<uint64_t> checksums(page_count);
+    auto copy_page = [&](uint64_t pgno, void const* data) {
+      auto sum = page_checksum(static_cast<unsigned char const*>(data), size_t(page_size));
+      checksums[pgno - 1] = sum;
+      if (pgno > previous.size() || previous[pgno - 1] != sum) {
+        dest.write(data, page_size, int64_t(pgno - 1) * page_size);
+        ++res.pages_written;
+      }
+    };
+
+    if (dbpage) {
+      for (auto row : *dbpage) {
+        auto pgno = uint64_t(row.get<long long int>(0));
+        if (pgno < 1 || pgno > page_count || row.column_bytes(1) != page_size)
+          throw database_error("incremental backup: unexpected page from sqlite_dbpage", SQLITE_CORRUPT);
+        copy_page(pgno, row.get<void const*>(1));
+      }
+    } else {
+      std::vector<unsigned char> page(page_size);
+      for (uint64_t pgno = 1; pgno <= page_count; ++pgno) {
+        int rc = file->pMethods->xRead(file, page.data(), page_size, int64_t(pgno - 1) * page_size);
+        if (rc != SQLITE_OK)
+          throw database_error("incremental backup: cannot read the source database", rc);
+        copy_page(pgno, page.data());
+      }
+    }
+    xct.commit();
+
+    dest.truncate(int64_t(page_count) * page_size);
+    dest.sync();
+    save_manifest(page_size, checksums);
+    return res;
+  }
+
+} // namespace sqlite3pp
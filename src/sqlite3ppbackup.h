@@ -0,0 +1,141 @@
+// sqlite3ppbackup.h
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3PPBACKUP_H
+#define SQLITE3PPBACKUP_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sqlite3pp.h"
+
+namespace sqlite3pp
+{
+  /** An online backup that runs on a background thread and stays out of the way of
+      writers: instead of `database::backup()`'s fixed number of pages per step, each step
+      copies as many pages as fit in `step_budget` at the copy rate measured so far, the
+      job sleeps `pause` between steps so writers can take the lock, and backs off on
+      `SQLITE_BUSY`/`SQLITE_LOCKED`, halving the step.
+      The two connections are used from the job's thread, so they must be in serialized
+      threading mode (the default) if they are used elsewhere meanwhile, and must outlive
+      the job. */
+  class backup_job : noncopyable
+  {
+   public:
+    struct options
+    {
+      std::chrono::microseconds step_budget = std::chrono::milliseconds(5);
+      std::chrono::milliseconds pause = std::chrono::milliseconds(10);
+      std::chrono::milliseconds busy_backoff = std::chrono::milliseconds(100);
+      int initial_pages = 16;
+      int max_pages = 65536;
+    };
+
+    struct progress
+    {
+      int remaining = 0;
+      int pagecount = 0;
+      int step_pages = 0;             // pages per step currently used
+      double pages_per_second = 0;    // pages copied over time spent, pauses included
+      bool done = false;
+      int rc = SQLITE_OK;             // the result once done
+    };
+
+    /// Starts backing up `source` (schema `sourcename`) into `dest` (schema `destname`).
+    backup_job(database& source, database& dest, options opts);
+    backup_job(database& source, database& dest, options opts,
+               char const* sourcename, char const* destname);
+    backup_job(database& source, database& dest)
+      : backup_job(source, dest, options()) {}
+
+    /// Cancels the job if it's still running and waits for it.
+    ~backup_job();
+
+    progress status() const;
+
+    /// Stops the job after the current step; `wait()` then returns `SQLITE_INTERRUPT`.
+    void cancel();
+
+    /// Waits for the job to end; returns `SQLITE_OK` when the backup is complete.
+    int wait();
+
+   private:
+    void run();
+    /// Sleeps for `d` unless cancelled; returns false if cancelled.
+    bool sleep(std::chrono::milliseconds d);
+
+    options const opts_;
+    sqlite3_backup* backup_;
+    mutable std::mutex mutex_;
+    std::condition_variable cancel_cond_;
+    bool cancelled_ = false;
+    progress progress_;
+    std::thread thread_;
+  };
+
+  /** Backs a database up into a plain database file, rewriting only the pages that changed
+      since the previous run. A sidecar manifest next to the destination (`<dest>.manifest`
+      by default) keeps the page size and a 64-bit checksum of every page; each run reads
+      the source pages in one read transaction, compares their checksums with the manifest
+      and writes the differing pages, so a mostly static database costs a full read but
+      only a few pages of writes.
+      Pages are read through the `sqlite_dbpage` virtual table when SQLite has it
+      (`SQLITE_ENABLE_DBPAGE_VTAB`). Otherwise they are read from the database file itself,
+      which is only consistent for rollback-journal databases, so a WAL database then throws.
+      The destination must not be written by anything else, and is only a valid database
+      once `run()` returns; the manifest is removed while the pages are written, so an
+      interrupted run is followed by a full copy. */
+  class incremental_backup : noncopyable
+  {
+   public:
+    struct result
+    {
+      uint64_t pages = 0;             // pages in the database
+      uint64_t pages_written = 0;     // pages that changed since the previous run
+    };
+
+    incremental_backup(database& source, std::string destpath, std::string manifestpath = {},
+                       char const* sourcename = "main");
+
+    result run();
+
+   private:
+    std::vector<uint64_t> load_manifest(int page_size) const;
+    void save_manifest(int page_size, std::vector<uint64_t> const& checksums) const;
+
+    database& source_;
+    std::string const destpath_;
+    std::string const manifestpath_;
+    std::string const sourcename_;
+  };
+
+} // namespace sqlite3pp
+
+#endif
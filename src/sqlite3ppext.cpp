@@ -22,7 +22,9 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <cstdint>
 #include <cstring>
+#include <regex>
 
 #include "sqlite3ppext.h"
 
@@ -57,6 +59,29 @@ namespace sqlite3pp
         ((function::function_handler&)*f)(c);
       }
 
+      void regexp_impl(sqlite3_context* ctx, int nargs, sqlite3_value** values)
+      {
+        context c(ctx, nargs, values);
+        if (c.args_type(0) == SQLITE_NULL || c.args_type(1) == SQLITE_NULL) {
+          c.result();
+          return;
+        }
+        try {
+          auto const& re = c.aux<std::regex>(0, [&c] {
+            auto pattern = c.get<std::string_view>(0);
+            return std::regex(pattern.begin(), pattern.end(), std::regex::ECMAScript);
+          });
+          auto text = c.get<std::string_view>(1);
+          c.result(std::regex_search(text.begin(), text.end(), re) ? 1 : 0);
+        }
+        catch (std::bad_alloc const&) {
+          sqlite3_result_error_nomem(ctx);
+        }
+        catch (std::exception const& ex) {
+          c.result_error(ex.what());
+        }
+      }
+
     } // namespace
 
     database borrow(sqlite3* pdb) {
@@ -68,6 +93,12 @@ namespace sqlite3pp
     {
     }
 
+    context::~context()
+    {
+      for (auto const& a : aux_)
+        sqlite3_set_auxdata(ctx_, a.idx, a.p, a.destroy);
+    }
+
     int context::args_count() const
     {
       return nargs_;
@@ -105,7 +136,12 @@ namespace sqlite3pp
 
     std::string context::get(int idx, std::string) const
     {
-      return get(idx, (char const*)0);
+      return std::string(get(idx, std::string_view()));
+    }
+
+    std::string_view context::get(int idx, std::string_view) const
+    {
+      return value_traits<std::string_view>::get(values_[idx]);
     }
 
     void const* context::get(int idx, void const*) const
@@ -132,7 +168,8 @@ namespace sqlite3pp
 
     void context::result(std::string const& value)
     {
-      result(value.c_str(), false);
+      // Usually a temporary or a local, so SQLite keeps a copy.
+      result_traits<std::string>::set(ctx_, value);
     }
 
     void context::result(char const* value, bool fcopy)
@@ -178,6 +215,47 @@ namespace sqlite3pp
     }
 #endif
 
+    namespace
+    {
+      class sqlite_memory_resource : public std::pmr::memory_resource
+      {
+        // sqlite3_malloc aligns to 8 bytes. For more, allocate extra and keep the pointer
+        // to free just before the aligned block.
+        static constexpr size_t natural = 8;
+
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+          size_t const extra = alignment > natural ? alignment : 0;
+          auto p = static_cast<char*>(sqlite3_malloc64(bytes + extra ? bytes + extra : 1));
+          if (!p)
+            throw std::bad_alloc();
+          if (!extra)
+            return p;
+          auto aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + alignment) & ~(uintptr_t(alignment) - 1));
+          std::memcpy(aligned - sizeof(p), &p, sizeof(p));
+          return aligned;
+        }
+
+        void do_deallocate(void* p, size_t, size_t alignment) override
+        {
+          if (alignment > natural)
+            std::memcpy(&p, static_cast<char*>(p) - sizeof(p), sizeof(p));
+          sqlite3_free(p);
+        }
+
+        bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override
+        {
+          return this == &other;
+        }
+      };
+    } // namespace
+
+    std::pmr::memory_resource* sqlite_memory()
+    {
+      static sqlite_memory_resource resource;
+      return &resource;
+    }
+
     function::function(database& db) : db_(db.db_)
     {
     }
@@ -188,6 +266,12 @@ namespace sqlite3pp
       return sqlite3_create_function(db_, name, nargs, SQLITE_UTF8, fh_[name].get(), function_impl, 0, 0);
     }
 
+    int function::create_regexp(char const* name)
+    {
+      return sqlite3_create_function(db_, name, 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS, 0,
+                                     regexp_impl, 0, 0);
+    }
+
     aggregate::aggregate(database& db) : db_(db.db_)
     {
     }
@@ -26,11 +26,18 @@
 #define SQLITE3PPEXT_H
 
 #include <cstddef>
+#include <exception>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "sqlite3pp.h"
 
@@ -78,17 +85,23 @@ namespace sqlite3pp
   {
     database borrow(sqlite3* pdb);
 
+    template <class T, class = void> struct value_traits;
+
     class context : noncopyable
     {
      public:
       explicit context(sqlite3_context* ctx, int nargs = 0, sqlite3_value** values = nullptr);
+      ~context();
 
       int args_count() const;
       int args_bytes(int idx) const;
       int args_type(int idx) const;
 
       template <class T> T get(int idx) const {
-        return get(idx, T());
+        if constexpr (std::is_same_v<T, void const*>)
+          return get(idx, T());
+        else
+          return value_traits<T>::get(values_[idx]);
       }
 
       void result(int value);
@@ -103,10 +116,24 @@ namespace sqlite3pp
       void result_error(char const* msg);
 
       void* aggregate_data(int size);
+
+      sqlite3_context* sqlite3_handle() const {return ctx_;}
 #if 0 // Disabled due to deprecation in SQLite 
 	  int aggregate_count();
 #endif
 
+      /** Returns the T cached for the argument idx, or else the T that make() returns, which
+          is cached when the call returns. SQLite keeps it for as long as the statement passes
+          the same constant in that argument, so e.g. a pattern is compiled once per statement
+          rather than once per row; it isn't kept for arguments that vary. */
+      template <class T, class F> T& aux(int idx, F&& make) {
+        if (auto p = sqlite3_get_auxdata(ctx_, idx))
+          return *static_cast<T*>(p);
+        std::unique_ptr<T> t(new T(make()));
+        aux_.push_back({idx, t.get(), [](void* p) { delete static_cast<T*>(p); }});
+        return *t.release();
+      }
+
       template <class... Ts>
       std::tuple<Ts...> to_tuple() {
         return to_tuple_impl(0, *this, std::tuple<Ts...>());
@@ -118,6 +145,7 @@ namespace sqlite3pp
       long long int get(int idx, long long int) const;
       char const* get(int idx, char const*) const;
       std::string get(int idx, std::string) const;
+      std::string_view get(int idx, std::string_view) const;
       void const* get(int idx, void const*) const;
 
       template<class H, class... Ts>
@@ -132,9 +160,18 @@ namespace sqlite3pp
       }
 
      private:
+      // Set as auxdata when the call is done with it, as SQLite may destroy it right away.
+      struct pending_aux
+      {
+        int idx;
+        void* p;
+        void (*destroy)(void*);
+      };
+
       sqlite3_context* ctx_;
       int nargs_;
       sqlite3_value** values_;
+      std::vector<pending_aux> aux_;
     };
 
     namespace
@@ -148,6 +185,127 @@ namespace sqlite3pp
       }
     }
 
+    /** Compile-time mapping of a function argument type to the `sqlite3_value_*` call that
+        reads it, used by `function::create<F>()` and `context::get<T>()`. string_view and blob refer to SQLite's copy
+        of the value, which is valid for the duration of the call. */
+    template <class T> struct value_traits<T, std::enable_if_t<std::is_integral_v<T>>> {
+      static T get(sqlite3_value* v)                  {return T(sqlite3_value_int64(v));}
+    };
+    template <class T> struct value_traits<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+      static T get(sqlite3_value* v)                  {return T(sqlite3_value_double(v));}
+    };
+    template <> struct value_traits<char const*> {
+      static char const* get(sqlite3_value* v)        {return reinterpret_cast<char const*>(sqlite3_value_text(v));}
+    };
+    template <> struct value_traits<std::string_view> {
+      static std::string_view get(sqlite3_value* v) {
+        auto text = reinterpret_cast<char const*>(sqlite3_value_text(v));
+        if (!text)
+          return {};
+        return {text, size_t(sqlite3_value_bytes(v))};
+      }
+    };
+    template <> struct value_traits<std::string> {
+      static std::string get(sqlite3_value* v)       {return std::string(value_traits<std::string_view>::get(v));}
+    };
+    template <> struct value_traits<blob> {
+      static blob get(sqlite3_value* v) {
+        auto data = sqlite3_value_blob(v);
+        return {data, size_t(sqlite3_value_bytes(v)), nocopy};
+      }
+    };
+    template <class T> struct value_traits<std::optional<T>> {
+      static std::optional<T> get(sqlite3_value* v) {
+        if (sqlite3_value_type(v) == SQLITE_NULL)
+          return std::nullopt;
+        return value_traits<T>::get(v);
+      }
+    };
+
+    /** Compile-time mapping of a function's return type to the `sqlite3_result_*` call that
+        returns it. Text is always copied; a blob is copied if its `fcopy` says so. Unsigned
+        64-bit values beyond INT64_MAX are returned as REAL. */
+    template <class T, class = void> struct result_traits;
+
+    template <class T> struct result_traits<T, std::enable_if_t<std::is_integral_v<T>>> {
+      static void set(sqlite3_context* ctx, T value) {
+        if constexpr (std::is_unsigned_v<T> && sizeof(T) >= sizeof(sqlite3_int64)) {
+          if (value > T(INT64_MAX)) {
+            sqlite3_result_double(ctx, double(value));
+            return;
+          }
+        }
+        sqlite3_result_int64(ctx, sqlite3_int64(value));
+      }
+    };
+    template <class T> struct result_traits<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+      static void set(sqlite3_context* ctx, T value)               {sqlite3_result_double(ctx, double(value));}
+    };
+    template <> struct result_traits<std::string_view> {
+      static void set(sqlite3_context* ctx, std::string_view value) {
+        sqlite3_result_text64(ctx, value.data(), value.size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+      }
+    };
+    template <> struct result_traits<char const*> {
+      static void set(sqlite3_context* ctx, char const* value) {
+        if (value)
+          sqlite3_result_text(ctx, value, -1, SQLITE_TRANSIENT);
+        else
+          sqlite3_result_null(ctx);
+      }
+    };
+    template <> struct result_traits<std::string> {
+      static void set(sqlite3_context* ctx, std::string const& value) {
+        result_traits<std::string_view>::set(ctx, value);
+      }
+    };
+    template <> struct result_traits<blob> {
+      static void set(sqlite3_context* ctx, blob const& value) {
+        sqlite3_result_blob64(ctx, value.data, value.size, value.fcopy == copy ? SQLITE_TRANSIENT : SQLITE_STATIC);
+      }
+    };
+    template <> struct result_traits<null_type> {
+      static void set(sqlite3_context* ctx, null_type)             {sqlite3_result_null(ctx);}
+    };
+    template <class T> struct result_traits<std::optional<T>> {
+      static void set(sqlite3_context* ctx, std::optional<T> const& value) {
+        if (value)
+          result_traits<T>::set(ctx, *value);
+        else
+          sqlite3_result_null(ctx);
+      }
+    };
+
+    namespace
+    {
+      template <auto F, class R, class... Ps, size_t... Is>
+      void functiond_call(sqlite3_context* ctx, sqlite3_value** values, std::index_sequence<Is...>)
+      {
+        (void) values;
+        if constexpr (std::is_void_v<R>) {
+          F(value_traits<std::decay_t<Ps>>::get(values[Is])...);
+          sqlite3_result_null(ctx);
+        }
+        else {
+          result_traits<std::decay_t<R>>::set(ctx, F(value_traits<std::decay_t<Ps>>::get(values[Is])...));
+        }
+      }
+
+      template <auto F, class R, class... Ps>
+      void functiond_impl(sqlite3_context* ctx, int, sqlite3_value** values)
+      {
+        try {
+          functiond_call<F, R, Ps...>(ctx, values, std::index_sequence_for<Ps...>());
+        }
+        catch (std::bad_alloc const&) {
+          sqlite3_result_error_nomem(ctx);
+        }
+        catch (std::exception const& ex) {
+          sqlite3_result_error(ctx, ex.what(), -1);
+        }
+      }
+    }
+
     class function : noncopyable
     {
      public:
@@ -158,12 +316,31 @@ namespace sqlite3pp
 
       int create(char const* name, function_handler h, int nargs = 0);
 
+      /// Registers regexp(pattern, text), which also implements `text REGEXP pattern`, as a
+      /// std::regex (ECMAScript) search. Patterns are compiled once per statement.
+      int create_regexp(char const* name = "regexp");
+
       template <class F> int create(char const* name, std::function<F> h) {
         fh_[name] = std::shared_ptr<void>(new std::function<F>(h));
         return create_function_impl<F>()(db_, fh_[name].get(), name);
       }
 
+      /** Registers the function pointer F, which SQLite calls directly: arguments are read
+          straight from the values by their types (see value_traits), with no std::function,
+          tuple or copy of text in between. A stateless lambda can be passed as
+          `create<+lambda>` from a constexpr variable. `flags` such as SQLITE_DETERMINISTIC,
+          SQLITE_INNOCUOUS or SQLITE_DIRECTONLY let SQLite factor out constant calls and
+          restrict where the function may be used. Exceptions become SQL errors. */
+      template <auto F> int create(char const* name, int flags = 0) {
+        return create_direct<F>(name, flags, F);
+      }
+
      private:
+      template <auto F, class R, class... Ps>
+      int create_direct(char const* name, int flags, R (*)(Ps...)) {
+        return sqlite3_create_function_v2(db_, name, sizeof...(Ps), SQLITE_UTF8 | flags, 0,
+                                          functiond_impl<F, R, Ps...>, 0, 0, 0);
+      }
 
       template<class R, class... Ps>
       struct create_function_impl;
@@ -184,27 +361,167 @@ namespace sqlite3pp
       std::map<std::string, pfunction_base> fh_;
     };
 
+    /// A memory_resource over sqlite3_malloc64, so memory it hands out counts toward
+    /// SQLite's heap limits.
+    std::pmr::memory_resource* sqlite_memory();
+
     namespace
     {
+      /** The state of an aggregate T in its sqlite3_aggregate_context, which SQLite
+          zero-fills on first use. T is constructed in place by the first step and destroyed
+          by xFinal, which SQLite also calls when a query fails or is reset early. If T can be
+          constructed from a std::pmr::memory_resource*, it gets a pool over SQLite's heap
+          for its members, released in one go with the state. */
+      template <class T>
+      class aggregate_state
+      {
+        static constexpr bool pooled = std::is_constructible_v<T, std::pmr::memory_resource*>;
+        using pool_type = std::pmr::unsynchronized_pool_resource;
+        static_assert(alignof(pool_type) <= 8, "sqlite3_malloc only aligns to 8 bytes");
+
+        struct slot
+        {
+          T* t;
+          pool_type* pool;
+          unsigned char pool_storage[pooled ? sizeof(pool_type) : 1];
+          unsigned char t_storage[sizeof(T) + alignof(T)];
+        };
+
+       public:
+        /// The state of the group, or nullptr if no row was stepped into it.
+        static T* find(sqlite3_context* ctx) {
+          auto s = static_cast<slot*>(sqlite3_aggregate_context(ctx, 0));
+          return s ? s->t : nullptr;
+        }
+
+        static T& get(sqlite3_context* ctx) {
+          auto s = static_cast<slot*>(sqlite3_aggregate_context(ctx, int(sizeof(slot))));
+          if (!s)
+            throw std::bad_alloc();
+          if (!s->t) {
+            void* p = s->t_storage;
+            size_t space = sizeof(s->t_storage);
+            p = std::align(alignof(T), sizeof(T), p, space);
+            if constexpr (pooled) {
+              s->pool = new (s->pool_storage) pool_type(sqlite_memory());
+              try {
+                s->t = new (p) T(static_cast<std::pmr::memory_resource*>(s->pool));
+              }
+              catch (...) {
+                s->pool->~pool_type();
+                s->pool = nullptr;
+                throw;
+              }
+            }
+            else {
+              s->t = new (p) T();
+            }
+          }
+          return *s->t;
+        }
+
+        static void destroy(sqlite3_context* ctx) {
+          auto s = static_cast<slot*>(sqlite3_aggregate_context(ctx, 0));
+          if (!s || !s->t)
+            return;
+          s->t->~T();
+          s->t = nullptr;
+          if constexpr (pooled) {
+            s->pool->~pool_type();
+            s->pool = nullptr;
+          }
+        }
+
+        /// Calls f with a fresh state, for the result of a group without rows.
+        template <class F> static void empty(F f) {
+          if constexpr (pooled) {
+            pool_type pool(sqlite_memory());
+            T t(static_cast<std::pmr::memory_resource*>(&pool));
+            f(t);
+          }
+          else {
+            T t{};
+            f(t);
+          }
+        }
+      };
+
+      template <class R>
+      void aggregate_result(sqlite3_context* ctx, R const& value)
+      {
+        result_traits<std::decay_t<R>>::set(ctx, value);
+      }
+
       template <class T, class... Ps>
       void stepx_impl(sqlite3_context* ctx, int nargs, sqlite3_value** values)
       {
         context c(ctx, nargs, values);
-        T* t = static_cast<T*>(c.aggregate_data(sizeof(T)));
-#if 0 // Disabled due to deprecation in SQLite 
-		if (c.aggregate_count() == 1) new (t) T;
-#endif
-		sqlite3pp::apply([](T* tt, Ps... ps){tt->step(ps...);},
-              std::tuple_cat(std::make_tuple(t), c.to_tuple<Ps...>()));
+        try {
+          T& t = aggregate_state<T>::get(ctx);
+          sqlite3pp::apply([&t](Ps... ps){t.step(ps...);}, c.to_tuple<Ps...>());
+        }
+        catch (std::bad_alloc const&) {
+          sqlite3_result_error_nomem(ctx);
+        }
+        catch (std::exception const& ex) {
+          c.result_error(ex.what());
+        }
+      }
+
+      template <class T, class... Ps>
+      void inversex_impl(sqlite3_context* ctx, int nargs, sqlite3_value** values)
+      {
+        context c(ctx, nargs, values);
+        try {
+          T& t = aggregate_state<T>::get(ctx);
+          sqlite3pp::apply([&t](Ps... ps){t.inverse(ps...);}, c.to_tuple<Ps...>());
+        }
+        catch (std::bad_alloc const&) {
+          sqlite3_result_error_nomem(ctx);
+        }
+        catch (std::exception const& ex) {
+          c.result_error(ex.what());
+        }
+      }
+
+      template <class T>
+      void valueN_impl(sqlite3_context* ctx)
+      {
+        try {
+          if (T* t = aggregate_state<T>::find(ctx))
+            aggregate_result(ctx, t->value());
+          else
+            aggregate_state<T>::empty([ctx](T& t){ aggregate_result(ctx, t.value()); });
+        }
+        catch (std::bad_alloc const&) {
+          sqlite3_result_error_nomem(ctx);
+        }
+        catch (std::exception const& ex) {
+          sqlite3_result_error(ctx, ex.what(), -1);
+        }
       }
 
       template <class T>
       void finishN_impl(sqlite3_context* ctx)
       {
-        context c(ctx);
-        T* t = static_cast<T*>(c.aggregate_data(sizeof(T)));
-        c.result(t->finish());
-        t->~T();
+        try {
+          if (T* t = aggregate_state<T>::find(ctx)) {
+            struct guard {
+              sqlite3_context* ctx;
+              ~guard() { aggregate_state<T>::destroy(ctx); }
+            } g{ctx};
+            aggregate_result(ctx, t->finish());
+          }
+          else {
+            aggregate_state<T>::empty([ctx](T& t){ aggregate_result(ctx, t.finish()); });
+          }
+        }
+        catch (std::bad_alloc const&) {
+          sqlite3_result_error_nomem(ctx);
+        }
+        catch (std::exception const& ex) {
+          sqlite3_result_error(ctx, ex.what(), -1);
+        }
       }
     }
 
@@ -218,11 +535,26 @@ namespace sqlite3pp
 
       int create(char const* name, function_handler s, function_handler f, int nargs = 1);
 
+      /** Registers T as an aggregate of Ps: a T is constructed for each group on its first
+          row, `step(Ps...)` is called for every row and `finish()` returns the result, after
+          which the T is destroyed. A group without rows gets the `finish()` of a fresh T.
+          Exceptions become SQL errors. */
       template <class T, class... Ps>
       int create(char const* name) {
         return sqlite3_create_function(db_, name, sizeof...(Ps), SQLITE_UTF8, 0, 0, stepx_impl<T, Ps...>, finishN_impl<T>);
       }
 
+      /** Registers T as an aggregate window function. Besides `step` and `finish`, T provides
+          `inverse(Ps...)`, which removes a row that left the frame, and `value()`, the
+          result for the current frame, so a sliding frame costs one step and one inverse per
+          row rather than a recomputation. */
+      template <class T, class... Ps>
+      int create_window(char const* name) {
+        return sqlite3_create_window_function(db_, name, sizeof...(Ps), SQLITE_UTF8, 0,
+                                              stepx_impl<T, Ps...>, finishN_impl<T>, valueN_impl<T>,
+                                              inversex_impl<T, Ps...>, 0);
+      }
+
     private:
       sqlite3* db_;
 
@@ -0,0 +1,278 @@
+// sqlite3pplob.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3pplob.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sqlite3pppool.h"
+
+namespace sqlite3pp
+{
+
+  large_object_store::large_object_store(database& db, std::string table, size_t chunk_size)
+    : db_(db), table_(std::move(table)), chunks_(table_ + "_chunks"), chunk_size_(chunk_size)
+  {
+    auto limit = sqlite3_limit(db_.sqlite3_handle(), SQLITE_LIMIT_LENGTH, -1);
+    if (chunk_size_ == 0 || chunk_size_ > size_t(limit))
+      throw database_error("chunk size must be between 1 and SQLITE_LIMIT_LENGTH", SQLITE_MISUSE);
+
+    db_.execute(("CREATE TABLE IF NOT EXISTS " + table_ +
+                 " (id INTEGER PRIMARY KEY, size INTEGER NOT NULL, chunk_size INTEGER NOT NULL)").c_str());
+    db_.execute(("CREATE TABLE IF NOT EXISTS " + chunks_ +
+                 " (id INTEGER PRIMARY KEY, data BLOB NOT NULL)").c_str());
+  }
+
+  int64_t large_object_store::insert_object(uint64_t size)
+  {
+    command cmd(db_, ("INSERT INTO " + table_ + " (size, chunk_size) VALUES (?, ?)").c_str());
+    cmd.bind(1, (long long int)size);
+    cmd.bind(2, (long long int)chunk_size_);
+    cmd.execute();
+    auto id = db_.last_insert_rowid();
+    if (id <= 0 || id > INT32_MAX)
+      throw database_error("large object ids are exhausted", SQLITE_FULL);
+    return id;
+  }
+
+  int64_t large_object_store::create(uint64_t size)
+  {
+    std::unique_ptr<transaction> xct;
+    if (sqlite3_get_autocommit(db_.sqlite3_handle()))
+      xct = std::make_unique<transaction>(db_, false, true);
+
+    // Chunk rowids keep the chunk index in their low 32 bits.
+    if (size / chunk_size_ + (size % chunk_size_ != 0) > UINT32_MAX)
+      throw database_error("large object has too many chunks for its chunk size", SQLITE_TOOBIG);
+
+    auto id = insert_object(size);
+    command cmd(db_, ("INSERT INTO " + chunks_ + " (id, data) VALUES (?, ?)").c_str());
+    uint64_t index = 0;
+    for (uint64_t done = 0; done < size || index == 0; done += chunk_size_, ++index) {
+      cmd.bind(1, (long long int)chunk_rowid(id, index));
+      cmd.bind(2, zeroblob{std::min<uint64_t>(chunk_size_, size - done)});
+      cmd.execute();
+      cmd.reset();
+    }
+    if (xct)
+      xct->commit();
+    return id;
+  }
+
+  int64_t large_object_store::create(std::istream& in)
+  {
+    std::unique_ptr<transaction> xct;
+    if (sqlite3_get_autocommit(db_.sqlite3_handle()))
+      xct = std::make_unique<transaction>(db_, false, true);
+
+    auto id = insert_object(0);
+    command cmd(db_, ("INSERT INTO " + chunks_ + " (id, data) VALUES (?, ?)").c_str());
+    std::vector<char> buffer(chunk_size_);
+    uint64_t size = 0;
+    for (uint64_t index = 0; ; ++index) {
+      in.read(buffer.data(), std::streamsize(buffer.size()));
+      auto n = size_t(in.gcount());
+      if (n == 0 && index > 0)
+        break;
+      if (index >= UINT32_MAX)
+        throw database_error("large object has too many chunks for its chunk size", SQLITE_TOOBIG);
+      cmd.bind(1, (long long int)chunk_rowid(id, index));
+      cmd.bind(2, blob{buffer.data(), n, nocopy});
+      cmd.execute();
+      cmd.reset();
+      size += n;
+      if (n < buffer.size())
+        break;
+    }
+    if (in.bad())
+      throw database_error("error reading the large object stream", SQLITE_IOERR);
+
+    command update(db_, ("UPDATE " + table_ + " SET size = ? WHERE id = ?").c_str());
+    update.bind(1, (long long int)size);
+    update.bind(2, (long long int)id);
+    update.execute();
+
+    if (xct)
+      xct->commit();
+    return id;
+  }
+
+  void large_object_store::remove(int64_t id)
+  {
+    std::unique_ptr<transaction> xct;
+    if (sqlite3_get_autocommit(db_.sqlite3_handle()))
+      xct = std::make_unique<transaction>(db_, false, true);
+
+    command chunks(db_, ("DELETE FROM " + chunks_ + " WHERE id BETWEEN ? AND ?").c_str());
+    chunks.bind(1, (long long int)chunk_rowid(id, 0));
+    chunks.bind(2, (long long int)chunk_rowid(id, UINT32_MAX));
+    chunks.execute();
+
+    command object(db_, ("DELETE FROM " + table_ + " WHERE id = ?").c_str());
+    object.bind(1, (long long int)id);
+    object.execute();
+
+    if (xct)
+      xct->commit();
+  }
+
+  uint64_t large_object_store::size(int64_t id)
+  {
+    return large_object(db_, table_, id).size();
+  }
+
+  large_object large_object_store::open(int64_t id, bool writeable)
+  {
+    return large_object(db_, table_, id, writeable);
+  }
+
+  uint64_t large_object_store::read(connection_pool& pool, int64_t id, void* dst, uint64_t len, uint64_t offset)
+  {
+    uint64_t size, chunk_size;
+    {
+      auto lease = pool.reader();
+      large_object object(lease, table_, id);
+      size = object.size();
+      chunk_size = object.chunk_size();
+    }
+    if (offset >= size)
+      return 0;
+    len = std::min(len, size - offset);
+    if (len == 0)
+      return 0;
+
+    auto const first = offset / chunk_size;
+    auto const last = (offset + len - 1) / chunk_size;
+    std::atomic<uint64_t> next{first};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto worker = [&] {
+      try {
+        auto lease = pool.reader();
+        large_object object(lease, table_, id);
+        for (auto index = next++; index <= last && !failed; index = next++) {
+          // The part of [offset, offset + len) that falls in this chunk.
+          auto begin = std::max(offset, index * chunk_size);
+          auto end = std::min(offset + len, (index + 1) * chunk_size);
+          auto n = object.read(static_cast<char*>(dst) + (begin - offset), end - begin, begin);
+          if (n != int64_t(end - begin))
+            throw database_error("short read from a large object chunk", SQLITE_CORRUPT);
+        }
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error)
+          error = std::current_exception();
+        failed = true;
+      }
+    };
+
+    auto nthreads = std::min<uint64_t>(std::max<size_t>(pool.max_readers(), 1), last - first + 1);
+    std::vector<std::thread> threads;
+    for (uint64_t i = 1; i < nthreads; ++i)
+      threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads)
+      t.join();
+
+    if (error)
+      std::rethrow_exception(error);
+    return len;
+  }
+
+
+  large_object::large_object(database& db, std::string const& table, int64_t id, bool writeable)
+    : db_(db), chunks_(table + "_chunks"), id_(id), writeable_(writeable)
+  {
+    query qry(db_, ("SELECT size, chunk_size FROM " + table + " WHERE id = ?").c_str());
+    qry.bind(1, (long long int)id);
+    auto i = qry.begin();
+    if (i == qry.end())
+      throw database_error("no such large object", SQLITE_NOTFOUND);
+    size_ = uint64_t((*i).get<long long int>(0));
+    chunk_size_ = uint64_t((*i).get<long long int>(1));
+    if (chunk_size_ == 0)
+      throw database_error("large object has a chunk size of 0", SQLITE_CORRUPT);
+  }
+
+  blob_handle& large_object::chunk(uint64_t index)
+  {
+    if (!blob_)
+      blob_ = std::make_unique<blob_handle>(db_, "main", chunks_.c_str(), "data",
+                                            large_object_store::chunk_rowid(id_, index), writeable_);
+    else if (current_ != index) {
+      try {
+        blob_->reopen(large_object_store::chunk_rowid(id_, index));
+      }
+      catch (...) {
+        // A failed reopen aborts the handle; open a fresh one next time.
+        blob_.reset();
+        throw;
+      }
+    }
+    current_ = index;
+    return *blob_;
+  }
+
+  int64_t large_object::read(void* dst, uint64_t len, uint64_t offset)
+  {
+    if (offset >= size_)
+      return -1;
+    len = std::min(len, size_ - offset);
+    uint64_t done = 0;
+    while (done < len) {
+      auto pos = offset + done;
+      auto n = std::min(len - done, chunk_size_ - pos % chunk_size_);
+      if (chunk(pos / chunk_size_).read(static_cast<char*>(dst) + done, size_t(n), pos % chunk_size_) != int64_t(n))
+        return -1;
+      done += n;
+    }
+    return int64_t(done);
+  }
+
+  int64_t large_object::write(void const* src, uint64_t len, uint64_t offset)
+  {
+    if (offset >= size_)
+      return -1;
+    len = std::min(len, size_ - offset);
+    uint64_t done = 0;
+    while (done < len) {
+      auto pos = offset + done;
+      auto n = std::min(len - done, chunk_size_ - pos % chunk_size_);
+      if (chunk(pos / chunk_size_).write(static_cast<char const*>(src) + done, size_t(n), pos % chunk_size_) != int64_t(n))
+        return -1;
+      done += n;
+    }
+    return int64_t(done);
+  }
+
+} // namespace sqlite3pp
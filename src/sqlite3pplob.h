@@ -0,0 +1,128 @@
+// sqlite3pplob.h
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3PPLOB_H
+#define SQLITE3PPLOB_H
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+
+#include "sqlite3pp.h"
+
+namespace sqlite3pp
+{
+  class connection_pool;
+  class large_object;
+
+  /** Objects larger than a single blob can be (`SQLITE_LIMIT_LENGTH`, 1 GB by default),
+      stored as fixed-size chunks in two tables:
+
+          <table>        (id INTEGER PRIMARY KEY, size INTEGER, chunk_size INTEGER)
+          <table>_chunks (id INTEGER PRIMARY KEY, data BLOB)
+
+      Chunk n of object id has the rowid `id << 32 | n`, so chunks are found without an
+      index and a `blob_handle` walks them with `reopen()`. Every chunk but the last is
+      `chunk_size` bytes. */
+  class large_object_store : noncopyable
+  {
+   public:
+    /** Creates the tables if necessary. `chunk_size` applies to objects created by this
+        store; existing objects keep theirs. */
+    explicit large_object_store(database& db,
+                                std::string table = "large_objects",
+                                size_t chunk_size = 1 << 20);
+
+    /// Creates an object of `size` zero bytes, to be filled in through `open()`.
+    /// Objects are limited to 2^32 - 1 chunks; larger ones throw SQLITE_TOOBIG.
+    int64_t create(uint64_t size);
+
+    /// Creates an object with the rest of `in`, read one chunk at a time.
+    int64_t create(std::istream& in);
+
+    void remove(int64_t id);
+
+    /// Throws if there is no such object.
+    uint64_t size(int64_t id);
+
+    large_object open(int64_t id, bool writeable = false);
+
+    /** Reads `len` bytes from `offset` into `dst`, spreading the chunks over up to
+        `pool.max_readers()` threads, each on its own pooled read connection. The pool must
+        be open on the same database file. Chunks are read in separate transactions, so
+        the object shouldn't be written meanwhile. Returns the number of bytes read, which
+        stops at the end of the object. */
+    uint64_t read(connection_pool& pool, int64_t id, void* dst, uint64_t len, uint64_t offset = 0);
+
+    std::string const& table() const          {return table_;}
+    size_t chunk_size() const                 {return chunk_size_;}
+
+    /// The rowid of chunk `index` of object `id`.
+    static int64_t chunk_rowid(int64_t id, uint64_t index) {return int64_t(uint64_t(id) << 32 | index);}
+
+   private:
+    int64_t insert_object(uint64_t size);
+
+    database& db_;
+    std::string const table_;
+    std::string const chunks_;
+    size_t const chunk_size_;
+  };
+
+  /** Random access to a stored object with 64-bit sizes and offsets. Reads and writes that
+      cross chunk boundaries are split over the chunks; one `blob_handle` is reopened from
+      chunk to chunk. Like a blob, an object can't be resized through the handle. */
+  class large_object : noncopyable
+  {
+   public:
+    large_object(database& db, std::string const& table, int64_t id, bool writeable = false);
+    large_object(large_object&&) = default;
+
+    int64_t id() const                        {return id_;}
+    uint64_t size() const                     {return size_;}
+    uint64_t chunk_size() const               {return chunk_size_;}
+
+    /// Returns the number of bytes read, which stops at the end of the object, or -1.
+    int64_t read(void* dst, uint64_t len, uint64_t offset);
+    /// Returns the number of bytes written, which stops at the end of the object, or -1.
+    int64_t write(void const* src, uint64_t len, uint64_t offset);
+
+   private:
+    blob_handle& chunk(uint64_t index);
+
+    database& db_;
+    std::string const chunks_;
+    int64_t const id_;
+    bool const writeable_;
+    uint64_t size_;
+    uint64_t chunk_size_;
+    std::unique_ptr<blob_handle> blob_;
+    uint64_t current_ = 0;
+  };
+
+} // namespace sqlite3pp
+
+#endif
@@ -0,0 +1,159 @@
+// sqlite3pppool.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3pppool.h"
+
+namespace sqlite3pp
+{
+
+  connection_pool::connection::connection(char const* dbname, int flags, char const* vfs)
+    : db(dbname, flags, vfs), functions(db), aggregates(db)
+  {
+  }
+
+  connection_pool::lease::lease(connection_pool* pool, connection* conn, bool writer)
+    : pool_(pool), conn_(conn), writer_(writer)
+  {
+  }
+
+  connection_pool::lease::lease(lease&& other)
+    : pool_(other.pool_), conn_(other.conn_), writer_(other.writer_)
+  {
+    other.conn_ = nullptr;
+  }
+
+  connection_pool::lease::~lease()
+  {
+    release();
+  }
+
+  connection_pool::connection& connection_pool::lease::conn() const
+  {
+    if (!conn_)
+      throw database_error("connection_pool: the lease was released", SQLITE_MISUSE);
+    return *conn_;
+  }
+
+  void connection_pool::lease::release()
+  {
+    if (conn_) {
+      pool_->release(conn_, writer_);
+      conn_ = nullptr;
+    }
+  }
+
+  connection_pool::connection_pool(char const* dbname, size_t max_readers, setup_handler setup,
+                                   int busy_timeout_ms, char const* vfs)
+    : dbname_(dbname), vfs_(vfs ? vfs : ""), max_readers_(max_readers),
+      setup_(std::move(setup)), busy_timeout_ms_(busy_timeout_ms)
+  {
+    // Without a reader to open, reader() would wait forever.
+    if (max_readers_ == 0)
+      throw database_error("connection_pool: max_readers must be at least 1", SQLITE_MISUSE);
+    writer_ = open(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    // Readers and the writer only run concurrently in WAL mode.
+    query qry(writer_->db, "PRAGMA journal_mode=WAL");
+    auto i = qry.begin();
+    if (i == qry.end() || (*i).get<std::string>(0) != "wal")
+      throw database_error("can't switch database to WAL mode", SQLITE_ERROR);
+  }
+
+  connection_pool::~connection_pool()
+  {
+    // Leases must not outlive the pool; destroying readers before the writer
+    // lets the last connection checkpoint and remove the WAL file.
+    readers_.clear();
+    writer_.reset();
+  }
+
+  std::unique_ptr<connection_pool::connection> connection_pool::open(int flags)
+  {
+    // Each connection is only ever used by one thread at a time.
+    flags |= SQLITE_OPEN_NOMUTEX;
+    auto conn = std::make_unique<connection>(dbname_.c_str(), flags,
+                                             vfs_.empty() ? nullptr : vfs_.c_str());
+    conn->db.set_busy_timeout(busy_timeout_ms_);
+    if (setup_)
+      setup_(*conn);
+    return conn;
+  }
+
+  connection_pool::lease connection_pool::reader()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (idle_readers_.empty()) {
+      if (opened_readers_ < max_readers_) {
+        // Claim the slot, then open outside the lock.
+        ++opened_readers_;
+        lock.unlock();
+        std::unique_ptr<connection> conn;
+        try {
+          conn = open(SQLITE_OPEN_READONLY);
+        } catch (...) {
+          lock.lock();
+          --opened_readers_;
+          readers_cond_.notify_one();
+          throw;
+        }
+        lock.lock();
+        readers_.push_back(std::move(conn));
+        return lease(this, readers_.back().get(), false);
+      }
+      readers_cond_.wait(lock);
+    }
+    auto conn = idle_readers_.back();
+    idle_readers_.pop_back();
+    return lease(this, conn, false);
+  }
+
+  connection_pool::lease connection_pool::writer()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    writer_cond_.wait(lock, [this] { return !writer_busy_; });
+    writer_busy_ = true;
+    return lease(this, writer_.get(), true);
+  }
+
+  void connection_pool::release(connection* conn, bool writer)
+  {
+    // Don't hand a connection with an abandoned transaction to the next user.
+    if (!sqlite3_get_autocommit(conn->db.sqlite3_handle())) {
+      auto exceptions = conn->db.exceptions();
+      conn->db.exceptions(false);
+      conn->db.execute("ROLLBACK");
+      conn->db.exceptions(exceptions);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (writer) {
+      writer_busy_ = false;
+      writer_cond_.notify_one();
+    } else {
+      idle_readers_.push_back(conn);
+      readers_cond_.notify_one();
+    }
+  }
+
+} // namespace sqlite3pp
@@ -0,0 +1,139 @@
+// sqlite3pppool.h
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3PPPOOL_H
+#define SQLITE3PPPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sqlite3pp.h"
+#include "sqlite3ppext.h"
+
+namespace sqlite3pp
+{
+  /** A pool of open connections to one database file: any number of read-only
+      connections and a single writer, with the database in WAL mode so readers
+      don't block on the writer. Connections are opened on demand and kept open,
+      so the open and schema parsing cost is paid once per connection.
+      Not usable with ":memory:" databases, since each connection would see its
+      own private database. */
+  class connection_pool : noncopyable
+  {
+   public:
+    /** One pooled connection, with the function/aggregate registries that keep
+        its user-defined SQL functions alive. */
+    class connection : noncopyable
+    {
+     public:
+      connection(char const* dbname, int flags, char const* vfs);
+
+      database db;
+      ext::function functions;
+      ext::aggregate aggregates;
+    };
+
+    /** Called once on every newly opened connection, to install hooks and
+        register functions. */
+    using setup_handler = std::function<void (connection&)>;
+
+    /** Exclusive use of a pooled connection; returns it to the pool when
+        destructed. Statements created on it must be destructed first. */
+    class lease : noncopyable
+    {
+     public:
+      lease(lease&& other);
+      ~lease();
+
+      /// The accessors throw SQLITE_MISUSE once the lease is released or moved from.
+      database& db() const                      {return conn().db;}
+      connection& conn() const;
+      database& operator* () const              {return conn().db;}
+      database* operator-> () const             {return &conn().db;}
+      operator database& () const               {return conn().db;}
+
+      /// False once the lease is released or moved from.
+      explicit operator bool() const            {return conn_ != nullptr;}
+
+      /** Returns the connection to the pool before destruction. */
+      void release();
+
+     private:
+      friend class connection_pool;
+      lease(connection_pool* pool, connection* conn, bool writer);
+
+      connection_pool* pool_;
+      connection* conn_;
+      bool writer_;
+    };
+
+    /** Opens the writer connection (creating the database if necessary) and
+        switches it to WAL mode. Up to `max_readers`, which must be at least 1, read-only
+        connections are opened later as they are needed. */
+    connection_pool(char const* dbname,
+                    size_t max_readers,
+                    setup_handler setup = {},
+                    int busy_timeout_ms = 5000,
+                    char const* vfs = nullptr);
+    ~connection_pool();
+
+    /** Leases a read-only connection, blocking while all of them are in use. */
+    lease reader();
+
+    /** Leases the writer connection, blocking while it's in use. */
+    lease writer();
+
+    size_t max_readers() const                  {return max_readers_;}
+    char const* filename() const                {return dbname_.c_str();}
+
+   private:
+    std::unique_ptr<connection> open(int flags);
+    void release(connection* conn, bool writer);
+
+    std::string const dbname_;
+    std::string const vfs_;
+    size_t const max_readers_;
+    setup_handler const setup_;
+    int const busy_timeout_ms_;
+
+    std::mutex mutex_;
+    std::condition_variable readers_cond_;
+    std::condition_variable writer_cond_;
+
+    std::unique_ptr<connection> writer_;
+    bool writer_busy_ = false;
+    size_t opened_readers_ = 0;
+    std::vector<std::unique_ptr<connection>> readers_;
+    std::vector<connection*> idle_readers_;
+  };
+
+} // namespace sqlite3pp
+
+#endif
@@ -0,0 +1,403 @@
+// sqlite3ppprofile.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <thread>
+
+#include "sqlite3ppprofile.h"
+
+namespace sqlite3pp
+{
+
+  namespace
+  {
+    std::atomic<uint64_t> next_profiler_id{1};
+
+    // Counters have a single writer, the shard's thread, so they needn't be incremented atomically.
+    inline void bump(std::atomic<uint64_t>& counter, uint64_t n)
+    {
+      counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    inline bool is_ident(char c)
+    {
+      return isalnum((unsigned char)c) || c == '_' || c == '$';
+    }
+
+    std::string escape_label(std::string const& s)
+    {
+      std::string out;
+      for (char c : s) {
+        if (c == '\\' || c == '"')
+          out += '\\';
+        if (c == '\n')
+          out += "\\n";
+        else
+          out += c;
+      }
+      return out;
+    }
+  } // namespace
+
+  struct profiler::counters
+  {
+    std::string sql;
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> rows{0};
+    std::atomic<uint64_t> fullscan_steps{0};
+    std::atomic<uint64_t> sorts{0};
+    std::atomic<uint64_t> autoindexes{0};
+    std::atomic<uint64_t> vm_steps{0};
+    std::array<std::atomic<uint64_t>, histogram_buckets> histogram{};
+  };
+
+  struct profiler::shard
+  {
+    // Held by the owning thread only while adding entries, and by readers.
+    std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<counters>> by_sql;
+
+    // Owning thread only: cache from statement text to its entry, keyed by views of raw_sql.
+    std::unordered_map<std::string_view, counters*> by_raw;
+    std::deque<std::string> raw_sql;
+    sqlite3_stmt* current_stmt = nullptr;
+    counters* current = nullptr;
+    // Start times of the statements running on this thread, innermost last. The durations
+    // SQLite reports have only millisecond resolution.
+    std::vector<std::pair<sqlite3_stmt*, std::chrono::steady_clock::time_point>> running;
+  };
+
+  profiler::profiler() : id_(next_profiler_id++)
+  {
+  }
+
+  profiler::~profiler()
+  {
+  }
+
+  int profiler::attach(database& db)
+  {
+    return sqlite3_trace_v2(db.sqlite3_handle(), SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW,
+                            trace_impl, this);
+  }
+
+  int profiler::detach(database& db)
+  {
+    return sqlite3_trace_v2(db.sqlite3_handle(), 0, nullptr, nullptr);
+  }
+
+  profiler::shard& profiler::local_shard()
+  {
+    struct cache { uint64_t id; shard* s; };
+    thread_local cache last{0, nullptr};
+    if (last.id == id_)
+      return *last.s;
+
+    // This thread may have used this profiler before, in between uses of another one.
+    thread_local std::unordered_map<uint64_t, shard*> shards;
+    auto& s = shards[id_];
+    if (!s) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      shards_.push_back(std::make_unique<shard>());
+      s = shards_.back().get();
+    }
+    last = {id_, s};
+    return *s;
+  }
+
+  profiler::counters* profiler::lookup(shard& s, sqlite3_stmt* stmt)
+  {
+    if (stmt == s.current_stmt)
+      return s.current;
+
+    // SQLite's internal statements, e.g. for parsing the schema, have no SQL.
+    char const* text = sqlite3_sql(stmt);
+    if (!text)
+      return nullptr;
+    std::string_view raw(text);
+    auto i = s.by_raw.find(raw);
+    counters* c;
+    if (i != s.by_raw.end()) {
+      c = i->second;
+    } else {
+      auto sql = normalize(raw);
+      auto j = s.by_sql.find(sql);
+      if (j == s.by_sql.end()) {
+        auto entry = std::make_unique<counters>();
+        entry->sql = sql;
+        std::lock_guard<std::mutex> lock(s.mutex);
+        j = s.by_sql.emplace(std::move(sql), std::move(entry)).first;
+      }
+      c = j->second.get();
+      // SQL with inlined literals would make this cache grow without bound.
+      if (s.by_raw.size() >= 10000) {
+        s.by_raw.clear();
+        s.raw_sql.clear();
+      }
+      s.raw_sql.emplace_back(raw);
+      s.by_raw.emplace(s.raw_sql.back(), c);
+    }
+    s.current_stmt = stmt;
+    s.current = c;
+    return c;
+  }
+
+  int profiler::trace_impl(unsigned type, void* ctx, void* p, void* x)
+  {
+    auto self = static_cast<profiler*>(ctx);
+    auto stmt = static_cast<sqlite3_stmt*>(p);
+    auto& s = self->local_shard();
+    switch (type) {
+      case SQLITE_TRACE_STMT:
+        // Trigger programs report as comments; their cost is part of the outer statement.
+        if (std::strncmp(static_cast<char const*>(x), "--", 2) != 0) {
+          // A new statement may have the address of a finalized one, so don't trust the cache.
+          s.current_stmt = nullptr;
+          if (self->lookup(s, stmt))
+            s.running.emplace_back(stmt, std::chrono::steady_clock::now());
+        }
+        break;
+      case SQLITE_TRACE_ROW:
+        if (auto c = self->lookup(s, stmt))
+          bump(c->rows, 1);
+        break;
+      case SQLITE_TRACE_PROFILE: {
+        auto c = self->lookup(s, stmt);
+        if (!c)
+          break;
+        auto ns = uint64_t(*static_cast<sqlite3_int64*>(x));
+        for (auto i = s.running.rbegin(); i != s.running.rend(); ++i) {
+          if (i->first == stmt) {
+            ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - i->second).count());
+            s.running.erase(std::next(i).base());
+            break;
+          }
+        }
+        bump(c->calls, 1);
+        bump(c->total_ns, ns);
+        size_t b = 0;
+        while (b < histogram_buckets - 1 && ns > bucket_bound_ns(b))
+          ++b;
+        bump(c->histogram[b], 1);
+        // Reset the statement's counters so the next run reports its own.
+        bump(c->fullscan_steps, sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1));
+        bump(c->sorts, sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1));
+        bump(c->autoindexes, sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1));
+        bump(c->vm_steps, sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1));
+        break;
+      }
+    }
+    return 0;
+  }
+
+  std::vector<profiler::statement_stats> profiler::snapshot() const
+  {
+    std::map<std::string, statement_stats> merged;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& s : shards_) {
+        std::lock_guard<std::mutex> shard_lock(s->mutex);
+        for (auto& e : s->by_sql) {
+          auto& c = *e.second;
+          auto& m = merged[e.first];
+          m.calls += c.calls.load(std::memory_order_relaxed);
+          m.total_ns += c.total_ns.load(std::memory_order_relaxed);
+          m.rows += c.rows.load(std::memory_order_relaxed);
+          m.fullscan_steps += c.fullscan_steps.load(std::memory_order_relaxed);
+          m.sorts += c.sorts.load(std::memory_order_relaxed);
+          m.autoindexes += c.autoindexes.load(std::memory_order_relaxed);
+          m.vm_steps += c.vm_steps.load(std::memory_order_relaxed);
+          for (size_t b = 0; b < histogram_buckets; ++b)
+            m.histogram[b] += c.histogram[b].load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    std::vector<statement_stats> stats;
+    stats.reserve(merged.size());
+    for (auto& m : merged) {
+      m.second.sql = m.first;
+      stats.push_back(std::move(m.second));
+    }
+    std::sort(stats.begin(), stats.end(), [](statement_stats const& a, statement_stats const& b) {
+      return a.total_ns > b.total_ns;
+    });
+    return stats;
+  }
+
+  void profiler::report(std::ostream& out, size_t top_n) const
+  {
+    auto stats = snapshot();
+    if (stats.size() > top_n)
+      stats.resize(top_n);
+
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << std::setw(10) << "calls" << std::setw(12) << "total ms" << std::setw(10) << "avg us"
+        << std::setw(10) << "p99 us" << std::setw(10) << "rows" << std::setw(10) << "fullscan"
+        << std::setw(8) << "sorts" << std::setw(8) << "autoidx" << std::setw(12) << "vm steps"
+        << "  sql\n";
+    out << std::fixed;
+    for (auto& s : stats) {
+      // The upper bound of the bucket holding the 99th percentile run.
+      uint64_t seen = 0;
+      size_t p99 = 0;
+      while (p99 < histogram_buckets - 1 && (seen += s.histogram[p99]) * 100 < s.calls * 99)
+        ++p99;
+      out << std::setw(10) << s.calls
+          << std::setw(12) << std::setprecision(3) << s.total_ns / 1e6
+          << std::setw(10) << std::setprecision(1) << (s.calls ? s.total_ns / 1e3 / s.calls : 0.0)
+          << std::setw(10) << bucket_bound_ns(p99) / 1000
+          << std::setw(10) << s.rows << std::setw(10) << s.fullscan_steps
+          << std::setw(8) << s.sorts << std::setw(8) << s.autoindexes << std::setw(12) << s.vm_steps
+          << "  " << s.sql << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+  }
+
+  void profiler::write_prometheus(std::ostream& out) const
+  {
+    auto stats = snapshot();
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out.unsetf(std::ios::floatfield);
+    out.precision(9);
+
+    struct metric { char const* name; char const* help; uint64_t statement_stats::* field; };
+    static metric const metrics[] = {
+      {"sqlite3pp_statement_rows_total", "Rows returned.", &statement_stats::rows},
+      {"sqlite3pp_statement_fullscan_steps_total", "Full table scan steps.", &statement_stats::fullscan_steps},
+      {"sqlite3pp_statement_sorts_total", "Sort operations.", &statement_stats::sorts},
+      {"sqlite3pp_statement_autoindexes_total", "Rows inserted into automatic indexes.", &statement_stats::autoindexes},
+      {"sqlite3pp_statement_vm_steps_total", "Virtual machine operations.", &statement_stats::vm_steps},
+    };
+    for (auto& m : metrics) {
+      out << "# HELP " << m.name << " " << m.help << "\n# TYPE " << m.name << " counter\n";
+      for (auto& s : stats)
+        out << m.name << "{sql=\"" << escape_label(s.sql) << "\"} " << s.*m.field << "\n";
+    }
+
+    char const* name = "sqlite3pp_statement_duration_seconds";
+    out << "# HELP " << name << " Statement run time.\n# TYPE " << name << " histogram\n";
+    for (auto& s : stats) {
+      auto label = escape_label(s.sql);
+      uint64_t cumulative = 0;
+      for (size_t b = 0; b < histogram_buckets - 1; ++b) {
+        cumulative += s.histogram[b];
+        out << name << "_bucket{sql=\"" << label << "\",le=\"" << bucket_bound_ns(b) / 1e9 << "\"} "
+            << cumulative << "\n";
+      }
+      out << name << "_bucket{sql=\"" << label << "\",le=\"+Inf\"} " << s.calls << "\n";
+      out << name << "_sum{sql=\"" << label << "\"} " << s.total_ns / 1e9 << "\n";
+      out << name << "_count{sql=\"" << label << "\"} " << s.calls << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+  }
+
+  bool profiler::write_prometheus(char const* path) const
+  {
+    std::string tmp = std::string(path) + ".tmp";
+    {
+      std::ofstream out(tmp);
+      write_prometheus(out);
+      out.close();
+      if (!out)
+        return false;
+    }
+    return std::rename(tmp.c_str(), path) == 0;
+  }
+
+  std::string profiler::normalize(std::string_view sql)
+  {
+    std::string out;
+    out.reserve(sql.size());
+    bool space = false;
+    size_t i = 0;
+    auto const n = sql.size();
+    while (i < n) {
+      char c = sql[i];
+      if (isspace((unsigned char)c)) {
+        space = true;
+        ++i;
+        continue;
+      }
+      if (c == '-' && i + 1 < n && sql[i + 1] == '-') {
+        while (i < n && sql[i] != '\n')
+          ++i;
+        space = true;
+        continue;
+      }
+      if (space && !out.empty())
+        out += ' ';
+      space = false;
+
+      bool const after_ident = !out.empty() && is_ident(out.back());
+      if (c == '\'' || ((c == 'x' || c == 'X') && i + 1 < n && sql[i + 1] == '\'' && !after_ident)) {
+        // String or blob literal; '' is an escaped quote.
+        i += (c == '\'') ? 1 : 2;
+        for (; i < n; ++i) {
+          if (sql[i] == '\'') {
+            if (i + 1 < n && sql[i + 1] == '\'')
+              ++i;
+            else
+              break;
+          }
+        }
+        ++i;
+        out += '?';
+      } else if (c == '"' || c == '`' || c == '[') {
+        // Quoted identifier, kept as is.
+        char close = c == '[' ? ']' : c;
+        auto end = sql.find(close, i + 1);
+        end = end == std::string_view::npos ? n : end + 1;
+        out.append(sql.substr(i, end - i));
+        i = end;
+      } else if (!after_ident && (isdigit((unsigned char)c) || (c == '.' && i + 1 < n && isdigit((unsigned char)sql[i + 1])))) {
+        // Numeric literal, including hex and exponents.
+        while (i < n && (is_ident(sql[i]) || sql[i] == '.'
+                         || ((sql[i] == '+' || sql[i] == '-') && (sql[i - 1] == 'e' || sql[i - 1] == 'E'))))
+          ++i;
+        out += '?';
+      } else {
+        out += c;
+        ++i;
+      }
+    }
+    return out;
+  }
+
+} // namespace sqlite3pp
@@ -0,0 +1,109 @@
+// sqlite3ppprofile.h
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3PPPROFILE_H
+#define SQLITE3PPPROFILE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "sqlite3pp.h"
+
+namespace sqlite3pp
+{
+  /** Per-statement profiling through `sqlite3_trace_v2`. Once attached to one or more
+      connections, it aggregates, per SQL text with literals replaced by `?`, the number of
+      runs, a latency histogram, the rows returned and the SQLITE_STMTSTATUS_FULLSCAN_STEP,
+      SORT, AUTOINDEX and VM_STEP counters. Each thread records into its own shard without
+      locking; reports merge the shards.
+      The profiler must outlive the connections it's attached to, or be detached first. */
+  class profiler : noncopyable
+  {
+   public:
+    /// Latency buckets are powers of two, from 1µs (bucket 0) to about 1s and above (last).
+    static constexpr size_t histogram_buckets = 22;
+
+    struct statement_stats
+    {
+      std::string sql;
+      uint64_t calls = 0;
+      uint64_t total_ns = 0;
+      uint64_t rows = 0;
+      uint64_t fullscan_steps = 0;
+      uint64_t sorts = 0;
+      uint64_t autoindexes = 0;
+      uint64_t vm_steps = 0;
+      std::array<uint64_t, histogram_buckets> histogram{};
+    };
+
+    profiler();
+    ~profiler();
+
+    /// Starts profiling the connection; replaces any other trace callback on it.
+    int attach(database& db);
+    int detach(database& db);
+
+    /// Merged statistics, sorted by total time, most expensive first.
+    std::vector<statement_stats> snapshot() const;
+
+    /// Writes a human-readable table of the `top_n` statements with the highest total time.
+    void report(std::ostream& out, size_t top_n = 20) const;
+
+    /// Writes the statistics in the Prometheus text exposition format.
+    void write_prometheus(std::ostream& out) const;
+    /// Writes them to a file, atomically replacing it; returns false on I/O errors.
+    bool write_prometheus(char const* path) const;
+
+    /// Replaces literals in `sql` by `?` and collapses whitespace.
+    static std::string normalize(std::string_view sql);
+
+    /// Upper bound, in nanoseconds, of histogram bucket `i`.
+    static uint64_t bucket_bound_ns(size_t i)   {return uint64_t(1000) << i;}
+
+   private:
+    struct counters;
+    struct shard;
+
+    static int trace_impl(unsigned type, void* ctx, void* p, void* x);
+    shard& local_shard();
+    counters* lookup(shard& s, sqlite3_stmt* stmt);
+
+    uint64_t const id_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<shard>> shards_;
+  };
+
+} // namespace sqlite3pp
+
+#endif
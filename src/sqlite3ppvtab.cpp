@@ -0,0 +1,112 @@
+// sqlite3ppvtab.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3ppvtab.h"
+
+namespace sqlite3pp
+{
+  namespace ext
+  {
+
+    index_info::index_info(sqlite3_index_info* info) : info_(info)
+    {
+    }
+
+    int index_info::constraint_count() const
+    {
+      return info_->nConstraint;
+    }
+
+    int index_info::constraint_column(int i) const
+    {
+      return info_->aConstraint[i].iColumn;
+    }
+
+    int index_info::constraint_op(int i) const
+    {
+      return info_->aConstraint[i].op;
+    }
+
+    bool index_info::constraint_usable(int i) const
+    {
+      return info_->aConstraint[i].usable != 0;
+    }
+
+    void index_info::use(int i, int argv_index, bool omit)
+    {
+      info_->aConstraintUsage[i].argvIndex = argv_index;
+      info_->aConstraintUsage[i].omit = omit ? 1 : 0;
+    }
+
+    int index_info::order_by_count() const
+    {
+      return info_->nOrderBy;
+    }
+
+    int index_info::order_by_column(int i) const
+    {
+      return info_->aOrderBy[i].iColumn;
+    }
+
+    bool index_info::order_by_desc(int i) const
+    {
+      return info_->aOrderBy[i].desc != 0;
+    }
+
+    void index_info::order_by_consumed(bool consumed)
+    {
+      info_->orderByConsumed = consumed ? 1 : 0;
+    }
+
+    void index_info::index(int num, char const* str)
+    {
+      if (info_->needToFreeIdxStr)
+        sqlite3_free(info_->idxStr);
+      info_->idxNum = num;
+      info_->idxStr = str ? sqlite3_mprintf("%s", str) : nullptr;
+      info_->needToFreeIdxStr = info_->idxStr ? 1 : 0;
+    }
+
+    void index_info::estimate(double cost, long long rows)
+    {
+      info_->estimatedCost = cost;
+      info_->estimatedRows = rows;
+    }
+
+    void index_info::unique(bool at_most_one_row)
+    {
+      if (at_most_one_row)
+        info_->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
+      else
+        info_->idxFlags &= ~SQLITE_INDEX_SCAN_UNIQUE;
+    }
+
+    module::module(database& db) : db_(db.sqlite3_handle())
+    {
+    }
+
+  } // namespace ext
+
+} // namespace sqlite3pp
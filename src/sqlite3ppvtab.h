@@ -0,0 +1,528 @@
+// sqlite3ppvtab.h
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3PPVTAB_H
+#define SQLITE3PPVTAB_H
+
+#include <array>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "sqlite3ppext.h"
+
+namespace sqlite3pp
+{
+  namespace ext
+  {
+    /** The planner's question to a virtual table: which of a scan's constraints and ORDER BY
+        terms can the table take over, and at what cost. Constraints passed on with `use()`
+        reach the cursor's `filter` as arguments, in `argv_index` order, together with the
+        number and string chosen by `index()`. */
+    class index_info
+    {
+     public:
+      explicit index_info(sqlite3_index_info* info);
+
+      int constraint_count() const;
+      int constraint_column(int i) const;   // -1 is the rowid
+      int constraint_op(int i) const;       // SQLITE_INDEX_CONSTRAINT_EQ, _GT, ...
+      bool constraint_usable(int i) const;
+      /// Passes constraint i to filter as argument argv_index (1-based). With omit, SQLite
+      /// trusts the cursor to apply it and doesn't check it again.
+      void use(int i, int argv_index, bool omit = true);
+
+      int order_by_count() const;
+      int order_by_column(int i) const;
+      bool order_by_desc(int i) const;
+      /// The cursor returns rows in ORDER BY order, so SQLite doesn't sort them.
+      void order_by_consumed(bool consumed = true);
+
+      void index(int num, char const* str = nullptr);   // str is copied
+      void estimate(double cost, long long rows);
+      void unique(bool at_most_one_row = true);
+
+      sqlite3_index_info* get() const { return info_; }
+
+     private:
+      sqlite3_index_info* info_;
+    };
+
+    namespace
+    {
+      template <class T, class = void>
+      struct has_best_index : std::false_type {};
+
+      template <class T>
+      struct has_best_index<T, std::void_t<decltype(std::declval<T&>().best_index(std::declval<index_info&>()))>>
+        : std::true_type {};
+
+      template <class T>
+      struct vtab_impl
+      {
+        using factory = std::function<std::unique_ptr<T> (std::vector<std::string> const&)>;
+
+        struct table : sqlite3_vtab
+        {
+          std::unique_ptr<T> t;
+        };
+
+        struct cursor : sqlite3_vtab_cursor
+        {
+          explicit cursor(T& t) : sqlite3_vtab_cursor(), c(t) {}
+          typename T::cursor c;
+        };
+
+        static int fail(sqlite3_vtab* vt, std::exception const& ex)
+        {
+          sqlite3_free(vt->zErrMsg);
+          vt->zErrMsg = sqlite3_mprintf("%s", ex.what());
+          auto dbe = dynamic_cast<database_error const*>(&ex);
+          return dbe ? dbe->error_code : SQLITE_ERROR;
+        }
+
+        static int connect(sqlite3* db, void* aux, int argc, char const* const* argv,
+                           sqlite3_vtab** vt, char** err)
+        {
+          try {
+            // argv holds the module, database and table names, then the module arguments.
+            std::vector<std::string> args(argv + 3, argv + argc);
+            std::unique_ptr<table> p(new table());
+            p->t = (*static_cast<factory*>(aux))(args);
+            if (!p->t) {
+              *err = sqlite3_mprintf("%s: no table", argv[0]);
+              return SQLITE_ERROR;
+            }
+            std::string const schema(p->t->schema());
+            int rc = sqlite3_declare_vtab(db, schema.c_str());
+            if (rc != SQLITE_OK) {
+              *err = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+              return rc;
+            }
+            *vt = p.release();
+            return SQLITE_OK;
+          }
+          catch (std::exception const& ex) {
+            *err = sqlite3_mprintf("%s", ex.what());
+            return SQLITE_ERROR;
+          }
+        }
+
+        static int disconnect(sqlite3_vtab* vt)
+        {
+          delete static_cast<table*>(vt);
+          return SQLITE_OK;
+        }
+
+        static int best_index(sqlite3_vtab* vt, sqlite3_index_info* info)
+        {
+          if constexpr (has_best_index<T>::value) {
+            try {
+              index_info ii(info);
+              return static_cast<table*>(vt)->t->best_index(ii);
+            }
+            catch (std::exception const& ex) {
+              return fail(vt, ex);
+            }
+          }
+          else {
+            (void) vt; (void) info;
+            return SQLITE_OK;   // a full scan, at SQLite's default cost
+          }
+        }
+
+        static int open(sqlite3_vtab* vt, sqlite3_vtab_cursor** cur)
+        {
+          try {
+            *cur = new cursor(*static_cast<table*>(vt)->t);
+            return SQLITE_OK;
+          }
+          catch (std::exception const& ex) {
+            return fail(vt, ex);
+          }
+        }
+
+        static int close(sqlite3_vtab_cursor* cur)
+        {
+          delete static_cast<cursor*>(cur);
+          return SQLITE_OK;
+        }
+
+        static int filter(sqlite3_vtab_cursor* cur, int idx_num, char const* idx_str,
+                          int argc, sqlite3_value** argv)
+        {
+          try {
+            context args(nullptr, argc, argv);
+            return static_cast<cursor*>(cur)->c.filter(idx_num, idx_str, args);
+          }
+          catch (std::exception const& ex) {
+            return fail(cur->pVtab, ex);
+          }
+        }
+
+        static int next(sqlite3_vtab_cursor* cur)
+        {
+          try {
+            return static_cast<cursor*>(cur)->c.next();
+          }
+          catch (std::exception const& ex) {
+            return fail(cur->pVtab, ex);
+          }
+        }
+
+        static int eof(sqlite3_vtab_cursor* cur)
+        {
+          return static_cast<cursor*>(cur)->c.eof() ? 1 : 0;
+        }
+
+        static int column(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col)
+        {
+          try {
+            context c(ctx);
+            static_cast<cursor*>(cur)->c.column(c, col);
+            return SQLITE_OK;
+          }
+          catch (std::exception const& ex) {
+            sqlite3_result_error(ctx, ex.what(), -1);
+            return SQLITE_ERROR;
+          }
+        }
+
+        static int rowid(sqlite3_vtab_cursor* cur, sqlite3_int64* id)
+        {
+          try {
+            *id = static_cast<cursor*>(cur)->c.rowid();
+            return SQLITE_OK;
+          }
+          catch (std::exception const& ex) {
+            return fail(cur->pVtab, ex);
+          }
+        }
+
+        static void destroy_factory(void* aux)
+        {
+          delete static_cast<factory*>(aux);
+        }
+
+        static sqlite3_module const* get()
+        {
+          static sqlite3_module const m = [] {
+            sqlite3_module m{};
+            // xCreate == xConnect makes the module eponymous: `FROM name` needs no
+            // CREATE VIRTUAL TABLE first.
+            m.xCreate = connect;
+            m.xConnect = connect;
+            m.xBestIndex = best_index;
+            m.xDisconnect = disconnect;
+            m.xDestroy = disconnect;
+            m.xOpen = open;
+            m.xClose = close;
+            m.xFilter = filter;
+            m.xNext = next;
+            m.xEof = eof;
+            m.xColumn = column;
+            m.xRowid = rowid;
+            return m;
+          }();
+          return &m;
+        }
+      };
+    }
+
+    /** Registers C++ classes as read-only virtual table modules, so SQL can run directly over
+        in-process containers instead of over a copy in a temp table. A table class T provides
+
+          std::string schema() const;     // "CREATE TABLE x(...)", for sqlite3_declare_vtab
+          int best_index(index_info&);    // optional; without it every query is a full scan
+          struct cursor {
+            explicit cursor(T&);
+            int filter(int idx_num, char const* idx_str, context& args);
+            int next();
+            bool eof() const;
+            void column(context& ctx, int col) const;
+            long long rowid() const;
+          };
+
+        `args` in filter holds the constraint values chosen by best_index; only its `get` and
+        `args_*` members apply. Modules are eponymous, so a table is created on first use of
+        its module name, with no arguments; `CREATE VIRTUAL TABLE t USING name(a, b)` passes
+        {"a", "b"} to the factory. SQLite owns the factory and releases it when the module is
+        replaced or the database closes. Exceptions become SQLite errors. */
+    class module : noncopyable
+    {
+     public:
+      template <class T>
+      using factory = std::function<std::unique_ptr<T> (std::vector<std::string> const& args)>;
+
+      explicit module(database& db);
+
+      /// Without a factory, tables are default-constructed.
+      template <class T> int create(char const* name, factory<T> f = nullptr) {
+        if (!f) {
+          if constexpr (std::is_default_constructible_v<T>)
+            f = [](std::vector<std::string> const&) { return std::make_unique<T>(); };
+          else
+            return SQLITE_MISUSE;
+        }
+        return sqlite3_create_module_v2(db_, name, vtab_impl<T>::get(), new factory<T>(std::move(f)),
+                                        vtab_impl<T>::destroy_factory);
+      }
+
+     private:
+      sqlite3* db_;
+    };
+
+
+    namespace
+    {
+      template <class T> struct column_type
+      {
+        static char const* name() {
+          if constexpr (std::is_integral_v<T>)
+            return " INTEGER";
+          else if constexpr (std::is_floating_point_v<T>)
+            return " REAL";
+          else if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view> ||
+                             std::is_same_v<T, char const*>)
+            return " TEXT";
+          else
+            return "";
+        }
+      };
+
+      template <class T> struct column_type<std::optional<T>> : column_type<T> {};
+
+      // Arguments are read again for the hidden columns after xFilter returns, when the
+      // sqlite3_value a view points into may be gone, so views are stored as strings.
+      template <class T> struct tvf_argument                    {using type = std::decay_t<T>;};
+      template <> struct tvf_argument<char const*>              {using type = std::string;};
+      template <> struct tvf_argument<std::string_view>         {using type = std::string;};
+
+      template <class P, class A>
+      decltype(auto) tvf_pass(A const& a)
+      {
+        if constexpr (std::is_same_v<std::decay_t<P>, char const*>)
+          return a.c_str();
+        else
+          return (a);
+      }
+
+      template <class T>
+      void column_result(context& c, T const& value)
+      {
+        result_traits<T>::set(c.sqlite3_handle(), value);
+      }
+
+      template <class Tuple, std::size_t... Is>
+      void column_result(context& c, Tuple const& t, int col, std::index_sequence<Is...>)
+      {
+        ((col == int(Is) ? column_result(c, std::get<Is>(t)) : void()), ...);
+      }
+
+      template <class R, class... Ps> class tvf_table;
+
+      /** Table of a table-valued function: columns of R, then one HIDDEN column per argument.
+          Equality constraints on the hidden columns, which is what `FROM name(a, b)` turns
+          into, become the arguments of the callable, whose generator then streams the rows. */
+      template <class... Cs, class... Ps>
+      class tvf_table<std::tuple<Cs...>, Ps...>
+      {
+       public:
+        using row = std::tuple<Cs...>;
+        using generator = std::function<std::optional<row> ()>;
+        using arguments = std::tuple<typename tvf_argument<std::decay_t<Ps>>::type...>;
+
+        static constexpr int ncolumns = int(sizeof...(Cs));
+        static constexpr int nparams = int(sizeof...(Ps));
+
+        struct spec
+        {
+          std::string name;
+          std::string schema;
+          std::vector<std::string> params;
+          std::function<generator (Ps...)> f;
+        };
+
+        explicit tvf_table(std::shared_ptr<spec const> s) : spec_(std::move(s)) {}
+
+        std::string const& schema() const { return spec_->schema; }
+
+        int best_index(index_info& info)
+        {
+          std::array<int, sizeof...(Ps)> found;
+          found.fill(-1);
+          unsigned unusable = 0;
+          for (int i = 0; i < info.constraint_count(); ++i) {
+            int const p = info.constraint_column(i) - ncolumns;
+            if (p < 0 || info.constraint_op(i) != SQLITE_INDEX_CONSTRAINT_EQ)
+              continue;
+            if (info.constraint_usable(i))
+              found[p] = i;
+            else
+              unusable |= 1u << p;
+          }
+          for (int p = 0; p < nparams; ++p) {
+            if (found[p] >= 0)
+              continue;
+            // Another join order may supply it; otherwise the call is missing the argument.
+            if (unusable & (1u << p))
+              return SQLITE_CONSTRAINT;
+            throw database_error((spec_->name + ": missing argument " + spec_->params[p]).c_str(), SQLITE_ERROR);
+          }
+          for (int p = 0; p < nparams; ++p)
+            info.use(found[p], p + 1);
+          info.estimate(1000, 1000);
+          return SQLITE_OK;
+        }
+
+        struct cursor
+        {
+          explicit cursor(tvf_table& t) : t_(t) {}
+
+          int filter(int, char const*, context& args)
+          {
+            read_args(args, std::index_sequence_for<Ps...>());
+            gen_ = call(std::index_sequence_for<Ps...>());
+            rowid_ = 0;
+            return next();
+          }
+
+          int next()
+          {
+            row_ = gen_ ? gen_() : std::nullopt;
+            ++rowid_;
+            return SQLITE_OK;
+          }
+
+          bool eof() const { return !row_; }
+
+          void column(context& ctx, int col) const
+          {
+            if (col < ncolumns)
+              column_result(ctx, *row_, col, std::index_sequence_for<Cs...>());
+            else
+              column_result(ctx, args_, col - ncolumns, std::index_sequence_for<Ps...>());
+          }
+
+          long long rowid() const { return rowid_; }
+
+         private:
+          template <std::size_t... Is>
+          void read_args(context& args, std::index_sequence<Is...>)
+          {
+            ((std::get<Is>(args_) = args.get<std::tuple_element_t<Is, arguments>>(int(Is))), ...);
+          }
+
+          template <std::size_t... Is>
+          generator call(std::index_sequence<Is...>)
+          {
+            return t_.spec_->f(tvf_pass<Ps>(std::get<Is>(args_))...);
+          }
+
+          tvf_table& t_;
+          arguments args_;
+          generator gen_;
+          std::optional<row> row_;
+          long long rowid_ = 0;
+        };
+
+       private:
+        std::shared_ptr<spec const> spec_;
+      };
+    }
+
+    /** Registers table-valued functions: a callable of the signature's arguments returns a
+        generator, called once per row until it returns nullopt, so
+        `SELECT * FROM name(?, ?)` streams rows without materializing them. The row type is a
+        std::tuple whose elements (any type with result_traits, e.g. integers, double,
+        std::string, std::optional of those) become the named columns; each argument becomes a HIDDEN column, which can
+        also be given as `WHERE param = ?`. All arguments are required; std::string_view and
+        char const* arguments point into a copy kept by the cursor, so the generator may hold them.
+
+          tf.create<std::tuple<long long> (long long, long long)>(
+            "series", {"value"}, {"start", "stop"}, [](long long start, long long stop) {
+              return [=]() mutable -> std::optional<std::tuple<long long>> {
+                if (start > stop) return std::nullopt;
+                return std::make_tuple(start++);
+              };
+            });
+    */
+    class table_function : noncopyable
+    {
+     public:
+      explicit table_function(database& db) : mod_(db) {}
+
+      template <class Sig, class F>
+      int create(char const* name, std::vector<std::string> const& columns,
+                 std::vector<std::string> const& params, F f) {
+        return create_impl(name, columns, params, std::move(f), static_cast<Sig*>(nullptr));
+      }
+
+     private:
+      template <class R, class... Ps, class F>
+      int create_impl(char const* name, std::vector<std::string> const& columns,
+                      std::vector<std::string> const& params, F f, R (*)(Ps...)) {
+        using table = tvf_table<R, Ps...>;
+        static_assert(table::nparams <= 32, "too many arguments");
+        if (int(columns.size()) != table::ncolumns || int(params.size()) != table::nparams)
+          return SQLITE_MISUSE;
+
+        auto s = std::make_shared<typename table::spec>();
+        s->name = name;
+        s->params = params;
+        s->f = std::move(f);
+        s->schema = "CREATE TABLE x(" + declare(columns, params, static_cast<R*>(nullptr),
+                                                static_cast<typename table::arguments*>(nullptr)) + ")";
+        return mod_.create<table>(name, [s](std::vector<std::string> const&) {
+          return std::make_unique<table>(s);
+        });
+      }
+
+      template <class... Cs, class... As>
+      static std::string declare(std::vector<std::string> const& columns, std::vector<std::string> const& params,
+                                 std::tuple<Cs...>*, std::tuple<As...>*) {
+        static_assert(sizeof...(Cs) > 0, "a table-valued function needs a column");
+        std::string decl;
+        std::size_t i = 0;
+        ((decl += (i ? ", " : "") + columns[i] + column_type<Cs>::name(), ++i), ...);
+        i = 0;
+        ((decl += ", " + params[i] + column_type<As>::name() + " HIDDEN", ++i), ...);
+        return decl;
+      }
+
+      module mod_;
+    };
+
+  } // namespace ext
+
+} // namespace sqlite3pp
+
+#endif
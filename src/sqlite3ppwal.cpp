@@ -0,0 +1,171 @@
+// sqlite3ppwal.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3ppwal.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace sqlite3pp
+{
+
+  checkpoint_manager::checkpoint_manager(char const* dbname, options opts, char const* vfs)
+    : opts_(opts), db_(dbname, SQLITE_OPEN_READWRITE, vfs)
+  {
+    db_.set_busy_timeout(int(opts_.busy_timeout.count()));
+    // The manager's own connection must not checkpoint on commit either.
+    sqlite3_wal_autocheckpoint(db_.sqlite3_handle(), 0);
+    // Reading the journal mode also opens the WAL on this connection.
+    std::string mode;
+    query qry(db_, "PRAGMA journal_mode");
+    for (auto row : qry)
+      mode = row.get<std::string>(0);
+    if (mode != "wal")
+      throw database_error("checkpoint_manager needs a database in WAL mode", SQLITE_MISUSE);
+    query size(db_, "PRAGMA page_size");
+    for (auto row : size)
+      page_size_ = row.get<long long int>(0);
+    thread_ = std::thread([this] {run();});
+  }
+
+  checkpoint_manager::~checkpoint_manager()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_cond_.notify_all();
+    done_cond_.notify_all();
+    thread_.join();
+  }
+
+  void checkpoint_manager::attach(database& db)
+  {
+    sqlite3_wal_hook(db.sqlite3_handle(), wal_hook, this);
+  }
+
+  void checkpoint_manager::detach(database& db)
+  {
+    sqlite3_wal_hook(db.sqlite3_handle(), nullptr, nullptr);
+    sqlite3_wal_autocheckpoint(db.sqlite3_handle(), 1000); // SQLite's default
+  }
+
+  checkpoint_manager::stats checkpoint_manager::status() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+  void checkpoint_manager::request()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      requested_ = true;
+    }
+    work_cond_.notify_one();
+  }
+
+  int checkpoint_manager::wal_hook(void* self, sqlite3*, char const* dbname, int frames)
+  {
+    if (std::strcmp(dbname, "main") == 0)
+      static_cast<checkpoint_manager*>(self)->on_commit(frames);
+    return SQLITE_OK;
+  }
+
+  void checkpoint_manager::on_commit(int frames)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // A WAL smaller than at the last checkpoint has been restarted from the beginning, and
+    // none of the new log is checkpointed, however far it grows before the next checkpoint.
+    if (frames < last_log_)
+      last_log_ = last_checkpointed_ = 0;
+    int behind = std::max(frames - last_checkpointed_, 0);
+    stats_.wal_frames = frames;
+    stats_.wal_bytes = frames ? 32 + int64_t(frames) * (page_size_ + 24) : 0;
+    stats_.frames_behind = behind;
+
+    if (frames >= opts_.passive_frames && !requested_) {
+      requested_ = true;
+      work_cond_.notify_one();
+    }
+
+    if (opts_.max_frames_behind > 0 && behind > opts_.max_frames_behind) {
+      ++stats_.throttled;
+      requested_ = true;
+      work_cond_.notify_one();
+      auto generation = generation_;
+      done_cond_.wait_for(lock, opts_.throttle_timeout, [&] {
+        return stop_ || (generation_ > generation && stats_.frames_behind <= opts_.max_frames_behind);
+      });
+    }
+  }
+
+  void checkpoint_manager::run()
+  {
+    using clock = std::chrono::steady_clock;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      work_cond_.wait(lock, [this] {return stop_ || requested_;});
+      if (stop_)
+        break;
+      requested_ = false;
+      lock.unlock();
+
+      // PASSIVE first. Only escalate once it has caught up: RESTART and TRUNCATE hold the
+      // writer lock while they wait, which is pointless while a reader still pins frames.
+      int log = 0, checkpointed = 0;
+      auto start = clock::now();
+      auto rc = sqlite3_wal_checkpoint_v2(db_.sqlite3_handle(), "main", SQLITE_CHECKPOINT_PASSIVE, &log, &checkpointed);
+      int escalated = 0;
+      if (rc == SQLITE_OK && checkpointed == log && opts_.restart_frames > 0 && log >= opts_.restart_frames) {
+        escalated = opts_.truncate ? SQLITE_CHECKPOINT_TRUNCATE : SQLITE_CHECKPOINT_RESTART;
+        rc = sqlite3_wal_checkpoint_v2(db_.sqlite3_handle(), "main", escalated, &log, &checkpointed);
+      }
+      auto duration = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start);
+
+      lock.lock();
+      ++stats_.passive;
+      if (escalated == SQLITE_CHECKPOINT_RESTART)
+        ++stats_.restart;
+      else if (escalated == SQLITE_CHECKPOINT_TRUNCATE)
+        ++stats_.truncate;
+      if (rc == SQLITE_BUSY || (rc == SQLITE_OK && checkpointed < log))
+        ++stats_.busy;
+      if ((rc == SQLITE_OK || rc == SQLITE_BUSY) && log >= 0) {
+        last_log_ = log;
+        last_checkpointed_ = checkpointed;
+        stats_.wal_frames = log;
+        stats_.wal_bytes = log > 0 ? 32 + int64_t(log) * (page_size_ + 24) : 0;
+        stats_.frames_behind = std::max(log - checkpointed, 0);
+      }
+      stats_.last_duration = duration;
+      stats_.max_duration = std::max(stats_.max_duration, duration);
+      stats_.total_duration += duration;
+      ++generation_;
+      done_cond_.notify_all();
+    }
+  }
+
+} // namespace sqlite3pp
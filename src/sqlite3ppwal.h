@@ -0,0 +1,116 @@
+// sqlite3ppwal.h
+//
+// The MIT License
+//
+// Copyright (c) 2015 Wongoo Lee (iwongu at gmail dot com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3PPWAL_H
+#define SQLITE3PPWAL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "sqlite3pp.h"
+
+namespace sqlite3pp
+{
+  /** Takes WAL checkpointing off the writers of a database file. `attach()` replaces a
+      connection's automatic checkpoints with a `sqlite3_wal_hook` that reports the WAL size
+      after every commit; when the WAL reaches `passive_frames`, a background thread runs a
+      PASSIVE checkpoint on its own connection. If that copied the whole WAL and the WAL has
+      reached `restart_frames`, it's followed by a RESTART (TRUNCATE if `truncate`), which
+      waits up to `busy_timeout` for readers to move on, so the WAL starts over.
+      When more than `max_frames_behind` frames aren't checkpointed yet, committing writers
+      are held in the hook, with no locks held, until a checkpoint catches up or
+      `throttle_timeout` passes.
+      Connections must be detached, or closed, before the manager is destructed. */
+  class checkpoint_manager : noncopyable
+  {
+   public:
+    struct options
+    {
+      int passive_frames = 1000;
+      int restart_frames = 10000;         // 0 never escalates
+      bool truncate = true;               // escalate to TRUNCATE rather than RESTART
+      int max_frames_behind = 100000;     // 0 never throttles writers
+      std::chrono::milliseconds throttle_timeout = std::chrono::seconds(5);
+      std::chrono::milliseconds busy_timeout = std::chrono::seconds(1);
+    };
+
+    struct stats
+    {
+      int wal_frames = 0;                 // as of the last commit or checkpoint
+      int64_t wal_bytes = 0;
+      int frames_behind = 0;              // WAL frames not yet copied into the database
+      uint64_t passive = 0;               // checkpoints run, by mode
+      uint64_t restart = 0;               // escalations after a PASSIVE one
+      uint64_t truncate = 0;
+      uint64_t busy = 0;                  // checkpoints that couldn't finish for readers or writers
+      uint64_t throttled = 0;             // commits held back by max_frames_behind
+      std::chrono::microseconds last_duration{0};
+      std::chrono::microseconds max_duration{0};
+      std::chrono::microseconds total_duration{0};
+    };
+
+    /// Opens the background connection to the database file, which should be in WAL mode.
+    checkpoint_manager(char const* dbname, options opts, char const* vfs = nullptr);
+    explicit checkpoint_manager(char const* dbname)
+      : checkpoint_manager(dbname, options()) {}
+    ~checkpoint_manager();
+
+    void attach(database& db);
+    /// Restores the connection's automatic checkpoints.
+    void detach(database& db);
+
+    stats status() const;
+
+    /// Asks for a checkpoint now, whatever the WAL size.
+    void request();
+
+   private:
+    static int wal_hook(void* self, sqlite3* db, char const* dbname, int frames);
+    void on_commit(int frames);
+    void run();
+
+    options const opts_;
+    database db_;
+    int64_t page_size_ = 0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cond_;
+    std::condition_variable done_cond_;
+    bool requested_ = false;
+    bool stop_ = false;
+    uint64_t generation_ = 0;             // checkpoints completed
+    int last_log_ = 0;                    // WAL frames and checkpointed frames at the last checkpoint
+    int last_checkpointed_ = 0;
+    stats stats_;
+    std::thread thread_;
+  };
+
+} // namespace sqlite3pp
+
+#endif
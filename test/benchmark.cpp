@@ -0,0 +1,416 @@
+// Measures the overhead of the wrapper's hot paths against the plain SQLite C API.
+//
+// $ make benchmark && ./test/benchmark
+//
+// Environment:
+//   SQLITE3PP_BENCH_MAX_ROWS   largest dataset, in rows (default 100000, up to 100000000)
+//   SQLITE3PP_BENCH_DB         database file to use besides ":memory:" (default: a file in /tmp)
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "sqlite3pp.h"
+#include "sqlite3ppext.h"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+#if !defined(BUILD_MONOLITHIC)
+
+// Counts heap allocations made through operator new, i.e. by the wrapper, not by SQLite.
+static atomic<size_t> allocations{0};
+
+// GCC pairs the free() of an inlined operator delete with the new-expression it came from
+// and warns; the replacement operators below are a matched malloc/free pair.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, memory_order_relaxed);
+  if (void* p = malloc(size ? size : 1))
+    return p;
+  throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#  pragma GCC diagnostic pop
+#endif
+
+static size_t allocation_count()
+{
+  return allocations.load(memory_order_relaxed);
+}
+
+#else
+
+// Replacing operator new would affect the whole monolithic build.
+static size_t allocation_count()
+{
+  return 0;
+}
+
+#endif
+
+static void measure(char const* name, size_t ops, function<void ()> const& f)
+{
+  auto allocs = allocation_count();
+  auto start = chrono::steady_clock::now();
+  f();
+  chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+  allocs = allocation_count() - allocs;
+  cout << "  " << left << setw(36) << name << right
+       << setw(12) << fixed << setprecision(1) << elapsed.count() / ops << " ns/op"
+       << setw(10) << setprecision(2) << double(allocs) / ops << " allocs/op" << endl;
+}
+
+static void create_table(sqlite3pp::database& db)
+{
+  db.execute("DROP TABLE IF EXISTS bench");
+  db.execute("CREATE TABLE bench (id INTEGER, name TEXT, score REAL)");
+}
+
+static void bench_inserts(sqlite3pp::database& db, size_t rows)
+{
+  vector<tuple<long long int, string, double>> data;
+  data.reserve(rows);
+  for (size_t i = 0; i < rows; ++i) {
+    data.emplace_back(i, "name" + to_string(i), i * 0.5);
+  }
+
+  create_table(db);
+  measure("insert: C API", rows, [&] {
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db.sqlite3_handle(), "INSERT INTO bench VALUES (?, ?, ?)", -1, &stmt, nullptr);
+    db.execute("BEGIN");
+    for (auto& row : data) {
+      sqlite3_bind_int64(stmt, 1, get<0>(row));
+      sqlite3_bind_text(stmt, 2, get<1>(row).data(), int(get<1>(row).size()), SQLITE_STATIC);
+      sqlite3_bind_double(stmt, 3, get<2>(row));
+      sqlite3_step(stmt);
+      sqlite3_reset(stmt);
+    }
+    db.execute("COMMIT");
+    sqlite3_finalize(stmt);
+  });
+
+  create_table(db);
+  measure("insert: command::bind", rows, [&] {
+    sqlite3pp::command cmd(db, "INSERT INTO bench VALUES (?, ?, ?)");
+    sqlite3pp::transaction xct(db);
+    for (auto& row : data) {
+      cmd.bind(1, get<0>(row));
+      cmd.bind(2, get<1>(row), sqlite3pp::nocopy);
+      cmd.bind(3, get<2>(row));
+      cmd.execute();
+      cmd.reset();
+    }
+    xct.commit();
+  });
+
+  create_table(db);
+  measure("insert: command::binder", rows, [&] {
+    sqlite3pp::command cmd(db, "INSERT INTO bench VALUES (?, ?, ?)");
+    sqlite3pp::transaction xct(db);
+    for (auto& row : data) {
+      cmd.binder() << get<0>(row) << get<1>(row) << get<2>(row);
+      cmd.execute();
+      cmd.reset();
+    }
+    xct.commit();
+  });
+
+  create_table(db);
+  measure("insert: typed_command", rows, [&] {
+    sqlite3pp::typed_command<long long int, string, double> cmd(db, "INSERT INTO bench VALUES (?, ?, ?)");
+    sqlite3pp::transaction xct(db);
+    for (auto& [id, name, score] : data) {
+      cmd.execute(id, name, score);
+    }
+    xct.commit();
+  });
+
+  create_table(db);
+  measure("insert: named parameters", rows, [&] {
+    sqlite3pp::command cmd(db, "INSERT INTO bench VALUES (:id, :name, :score)");
+    sqlite3pp::transaction xct(db);
+    for (auto& row : data) {
+      cmd.bind(":id", get<0>(row));
+      cmd.bind(":name", get<1>(row), sqlite3pp::nocopy);
+      cmd.bind(":score", get<2>(row));
+      cmd.execute();
+      cmd.reset();
+    }
+    xct.commit();
+  });
+
+  create_table(db);
+  measure("insert: named parameters, _param", rows, [&] {
+    using namespace sqlite3pp::literals;
+    sqlite3pp::command cmd(db, "INSERT INTO bench VALUES (:id, :name, :score)");
+    sqlite3pp::transaction xct(db);
+    for (auto& row : data) {
+      cmd.bind(":id"_param, get<0>(row));
+      cmd.bind(":name"_param, get<1>(row), sqlite3pp::nocopy);
+      cmd.bind(":score"_param, get<2>(row));
+      cmd.execute();
+      cmd.reset();
+    }
+    xct.commit();
+  });
+
+  create_table(db);
+  measure("insert: command::execute_batch", rows, [&] {
+    sqlite3pp::command cmd(db, "INSERT INTO bench VALUES (?, ?, ?)");
+    cmd.execute_batch(data, rows);
+  });
+
+  create_table(db);
+  measure("insert: bulk_loader", rows, [&] {
+    sqlite3pp::bulk_loader loader(db, "bench", {"id", "name", "score"});
+    loader.insert(data);
+  });
+}
+
+static void bench_queries(sqlite3pp::database& db, size_t rows)
+{
+  char const* sql = "SELECT id, name, score FROM bench";
+  long long int sum = 0;
+
+  measure("query: C API", rows, [&] {
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db.sqlite3_handle(), sql, -1, &stmt, nullptr);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      sum += sqlite3_column_int64(stmt, 0);
+      sum += sqlite3_column_bytes(stmt, 1) + (sqlite3_column_text(stmt, 1) != nullptr);
+      sum += (long long int)sqlite3_column_double(stmt, 2);
+    }
+    sqlite3_finalize(stmt);
+  });
+
+  measure("query: rows::get<T>", rows, [&] {
+    sqlite3pp::query qry(db, sql);
+    for (auto row : qry) {
+      sum += row.get<long long int>(0);
+      sum += row.get<string_view>(1).size();
+      sum += (long long int)row.get<double>(2);
+    }
+  });
+
+  measure("query: rows::getter", rows, [&] {
+    sqlite3pp::query qry(db, sql);
+    for (auto row : qry) {
+      long long int id;
+      string_view name;
+      double score;
+      row.getter() >> id >> name >> score;
+      sum += id + name.size() + (long long int)score;
+    }
+  });
+
+  measure("query: query::as", rows, [&] {
+    sqlite3pp::query qry(db, sql);
+    for (auto [id, name, score] : qry.as<long long int, string_view, double>()) {
+      sum += id + name.size() + (long long int)score;
+    }
+  });
+
+  measure("query: typed_query", rows, [&] {
+    sqlite3pp::typed_query<tuple<long long int>, tuple<long long int, string_view, double>> qry(
+      db, "SELECT id, name, score FROM bench WHERE id >= ?");
+    for (auto [id, name, score] : qry(0)) {
+      sum += id + name.size() + (long long int)score;
+    }
+  });
+
+  measure("query: query::fetch_columns", rows, [&] {
+    sqlite3pp::query qry(db, sql);
+    sqlite3pp::column_batch batch;
+    size_t n;
+    do {
+      n = qry.fetch_columns(batch, 1024);
+      for (size_t r = 0; r < n; ++r) {
+        sum += batch[0].integers[r] + batch[1].bytes(r).size() + (long long int)batch[2].reals[r];
+      }
+    } while (n == 1024);
+  });
+
+  if (sum == 42) {
+    cout << sum << endl;
+  }
+}
+
+static void bench_statements(sqlite3pp::database& db, size_t ops)
+{
+  char const* sql = "SELECT score FROM bench WHERE id = ?";
+
+  measure("prepare: sqlite3_prepare_v2", ops, [&] {
+    for (size_t i = 0; i < ops; ++i) {
+      sqlite3_stmt* stmt;
+      sqlite3_prepare_v2(db.sqlite3_handle(), sql, -1, &stmt, nullptr);
+      sqlite3_finalize(stmt);
+    }
+  });
+
+  sqlite3pp::query_cache cache(db);
+  measure("prepare: statement_cache hit", ops, [&] {
+    for (size_t i = 0; i < ops; ++i) {
+      auto qry = cache[sql];
+    }
+  });
+
+  measure("transaction: begin/commit", ops, [&] {
+    for (size_t i = 0; i < ops; ++i) {
+      sqlite3pp::transaction xct(db);
+      xct.commit();
+    }
+  });
+
+  measure("savepoint: open/release", ops, [&] {
+    for (size_t i = 0; i < ops; ++i) {
+      sqlite3pp::savepoint sp(db);
+      sp.commit();
+    }
+  });
+}
+
+static void twice(sqlite3_context* ctx, int, sqlite3_value** values)
+{
+  sqlite3_result_int64(ctx, sqlite3_value_int64(values[0]) * 2);
+}
+
+static long long int twice_direct(long long int n)
+{
+  return n * 2;
+}
+
+static void bench_functions(sqlite3pp::database& db, size_t rows)
+{
+  sqlite3_create_function(db.sqlite3_handle(), "c_twice", 1, SQLITE_UTF8, nullptr, twice, nullptr, nullptr);
+  sqlite3pp::ext::function func(db);
+  func.create<long long int (long long int)>("pp_twice", [](long long int n) { return n * 2; });
+  func.create<twice_direct>("pp_twice_direct", SQLITE_DETERMINISTIC);
+
+  measure("function: C API", rows, [&] {
+    sqlite3pp::query qry(db, "SELECT sum(c_twice(id)) FROM bench");
+    for (auto row : qry) {
+      (void)row;
+    }
+  });
+
+  measure("function: ext::function", rows, [&] {
+    sqlite3pp::query qry(db, "SELECT sum(pp_twice(id)) FROM bench");
+    for (auto row : qry) {
+      (void)row;
+    }
+  });
+
+  measure("function: ext::function create<F>", rows, [&] {
+    sqlite3pp::query qry(db, "SELECT sum(pp_twice_direct(id)) FROM bench");
+    for (auto row : qry) {
+      (void)row;
+    }
+  });
+}
+
+static long long int count_rows(sqlite3pp::database& db)
+{
+  sqlite3pp::query qry(db, "SELECT count(*) FROM bench");
+  return (*qry.begin()).get<long long int>(0);
+}
+
+// Time from nothing to the first query answered, for a prebuilt database image.
+static void bench_cold_start(sqlite3pp::database& db, string const& image)
+{
+  remove(image.c_str());
+  db.execute(("VACUUM INTO '" + image + "'").c_str());
+  long long int sum = 0;
+
+  measure("cold start: backup into :memory:", 1, [&] {
+    sqlite3pp::database src(image.c_str(), SQLITE_OPEN_READONLY);
+    sqlite3pp::database mem(":memory:");
+    src.backup(mem);
+    sum += count_rows(mem);
+  });
+
+  measure("cold start: load + deserialize", 1, [&] {
+    sqlite3pp::database mem(":memory:");
+    mem.deserialize(sqlite3pp::database_image::load(image.c_str()));
+    sum += count_rows(mem);
+  });
+
+  measure("cold start: map + deserialize", 1, [&] {
+    auto mapped = sqlite3pp::database_image::map(image.c_str());
+    sqlite3pp::database mem(":memory:");
+    mem.deserialize(mapped);
+    sum += count_rows(mem);
+  });
+
+  remove(image.c_str());
+  if (sum == 42) {
+    cout << sum << endl;
+  }
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main	sqlite3pp_benchmark_main
+#endif
+
+int main(void)
+{
+  try {
+    size_t max_rows = 100000;
+    if (char const* env = getenv("SQLITE3PP_BENCH_MAX_ROWS")) {
+      max_rows = strtoull(env, nullptr, 10);
+    }
+    string file = "/tmp/sqlite3pp_bench.db";
+    if (char const* env = getenv("SQLITE3PP_BENCH_DB")) {
+      file = env;
+    }
+
+    for (string dbname : {string(":memory:"), file}) {
+      for (size_t rows = 1000; rows <= max_rows; rows *= 10) {
+        cout << dbname << ", " << rows << " rows" << endl;
+        remove(file.c_str());
+        {
+          sqlite3pp::database db(dbname.c_str());
+          db.execute("PRAGMA journal_mode=WAL");
+          bench_inserts(db, rows);
+          bench_queries(db, rows);
+          bench_statements(db, 1000);
+          bench_functions(db, rows);
+          bench_cold_start(db, file + ".image");
+        }
+        cout << endl;
+      }
+    }
+    remove(file.c_str());
+    remove((file + "-wal").c_str());
+    remove((file + "-shm").c_str());
+  }
+  catch (exception& ex) {
+    cout << ex.what() << endl;
+  }
+  return 0;
+}
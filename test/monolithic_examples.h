@@ -8,14 +8,24 @@ extern "C" {
 #endif
 
 int sqlite3pp_aggregate_test_main(void);
+int sqlite3pp_async_test_main(void);
 int sqlite3pp_attach_test_main(void);
 int sqlite3pp_backup_test_main(void);
+int sqlite3pp_benchmark_main(void);
+int sqlite3pp_blob_test_main(void);
+int sqlite3pp_cache_test_main(void);
 int sqlite3pp_callback_test_main(void);
 int sqlite3pp_disconnect_test_main(void);
 int sqlite3pp_function_test_main(void);
 int sqlite3pp_insert_all_test_main(void);
 int sqlite3pp_insert_test_main(void);
+int sqlite3pp_lob_test_main(void);
+int sqlite3pp_pool_test_main(void);
+int sqlite3pp_profile_test_main(void);
 int sqlite3pp_select_test_main(void);
+int sqlite3pp_serialize_test_main(void);
+int sqlite3pp_vtab_test_main(void);
+int sqlite3pp_wal_test_main(void);
 
 #ifdef __cplusplus
 }
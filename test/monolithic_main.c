@@ -8,14 +8,24 @@
 // declare your own monolith dispatch table:
 MONOLITHIC_CMD_TABLE_START()
 	{ "aggregate", { .f = sqlite3pp_aggregate_test_main } },
+	{ "async", { .f = sqlite3pp_async_test_main } },
 	{ "attach", { .f = sqlite3pp_attach_test_main } },
 	{ "backup", { .f = sqlite3pp_backup_test_main } },
+	{ "benchmark", { .f = sqlite3pp_benchmark_main } },
+	{ "blob", { .f = sqlite3pp_blob_test_main } },
+	{ "cache", { .f = sqlite3pp_cache_test_main } },
 	{ "callback", { .f = sqlite3pp_callback_test_main } },
 	{ "disconnect", { .f = sqlite3pp_disconnect_test_main } },
 	{ "function", { .f = sqlite3pp_function_test_main } },
 	{ "insert_all", { .f = sqlite3pp_insert_all_test_main } },
 	{ "insert", { .f = sqlite3pp_insert_test_main } },
+	{ "lob", { .f = sqlite3pp_lob_test_main } },
+	{ "pool", { .f = sqlite3pp_pool_test_main } },
+	{ "profile", { .f = sqlite3pp_profile_test_main } },
 	{ "select", { .f = sqlite3pp_select_test_main } },
+	{ "serialize", { .f = sqlite3pp_serialize_test_main } },
+	{ "vtab", { .f = sqlite3pp_vtab_test_main } },
+	{ "wal", { .f = sqlite3pp_wal_test_main } },
 MONOLITHIC_CMD_TABLE_END();
 
 #include "monolithic_main_tpl.h"
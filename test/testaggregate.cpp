@@ -1,4 +1,7 @@
+#include <memory_resource>
+#include <stdexcept>
 #include <string>
+#include <unordered_set>
 #include <iostream>
 #include "sqlite3pp.h"
 #include "sqlite3ppext.h"
@@ -91,6 +94,38 @@ struct plussum
   int n_;
 };
 
+struct movingsum
+{
+  void step(int n) {
+    n_ += n;
+  }
+  void inverse(int n) {
+    n_ -= n;
+  }
+  int value() {
+    return n_;
+  }
+  int finish() {
+    return n_;
+  }
+  int n_;
+};
+
+// Its members allocate from a pool owned by the group's state.
+struct distinctcnt
+{
+  explicit distinctcnt(std::pmr::memory_resource* mr) : seen_(mr) {}
+  void step(int n) {
+    if (n < 0)
+      throw std::invalid_argument("distinctcnt: negative value");
+    seen_.insert(n);
+  }
+  int finish() {
+    return static_cast<int>(seen_.size());
+  }
+  std::pmr::unordered_set<int> seen_;
+};
+
 
 #if defined(BUILD_MONOLITHIC)
 #define main	sqlite3pp_aggregate_test_main
@@ -124,6 +159,41 @@ int main(void)
       cout << endl;
     }
     cout << endl;
+
+    cout << aggr.create_window<movingsum, int>("a7") << endl;
+    qry.prepare("SELECT id, a7(id) OVER (ORDER BY id ROWS BETWEEN 2 PRECEDING AND CURRENT ROW) FROM foods LIMIT 5");
+    for (auto row : qry) {
+      cout << row.get<int>(0) << "\t" << row.get<int>(1) << endl;
+    }
+
+    cout << aggr.create<distinctcnt, int>("a8") << endl;
+    qry.prepare("SELECT type_id, a8(id % 4), a4(), a5(name) FROM foods GROUP BY type_id");
+    for (auto row : qry) {
+      cout << row.get<int>(0) << "\t" << row.get<int>(1) << "\t" << row.get<int>(2) << "\t" << row.get<int>(3) << endl;
+    }
+
+    // A group without rows still gets a result.
+    qry.prepare("SELECT a8(id), a4(), a2(name) FROM foods WHERE 0");
+    for (auto row : qry) {
+      cout << row.get<int>(0) << "\t" << row.get<int>(1) << "\t'" << row.get<string>(2) << "'" << endl;
+    }
+
+    // Results convert like function results: float finishes as REAL.
+    cout << aggr.create<mysum<float>, double>("a9") << endl;
+    qry.prepare("SELECT a9(id * 0.5) FROM foods");
+    for (auto row : qry) {
+      cout << row.get<double>(0) << endl;
+    }
+
+    sqlite3pp::query bad(db, "SELECT a8(-id) FROM foods");
+    try {
+      for (auto row : bad) {
+        (void)row;
+      }
+    }
+    catch (exception& ex) {
+      cout << ex.what() << endl;
+    }
   }
   catch (exception& ex) {
     cout << ex.what() << endl;
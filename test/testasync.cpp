@@ -0,0 +1,117 @@
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <poll.h>
+#include "sqlite3pp.h"
+#include "sqlite3ppasync.h"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main	sqlite3pp_async_test_main
+#endif
+
+#ifdef SQLITE3PP_COROUTINES
+// A coroutine that starts eagerly and isn't awaited by anyone.
+struct detached
+{
+  struct promise_type
+  {
+    detached get_return_object()              {return {};}
+    std::suspend_never initial_suspend() noexcept {return {};}
+    std::suspend_never final_suspend() noexcept   {return {};}
+    void return_void()                        {}
+    void unhandled_exception()                {std::terminate();}
+  };
+};
+
+detached lookup(sqlite3pp::async_executor& exec, thread::id loop, size_t& pending)
+{
+  auto rows = co_await exec.query<string>("SELECT phone FROM contacts WHERE name = ?", "Mike");
+  // The task is still sleeping when the coroutine gets here, so it suspends.
+  auto count = co_await exec.submit(false, [](sqlite3pp::database& db) {
+    this_thread::sleep_for(chrono::milliseconds(100));
+    sqlite3pp::query qry(db, "SELECT count(*) FROM contacts");
+    return (*qry.begin()).get<int>(0);
+  });
+  cout << "awaited: " << get<0>(rows.at(0)) << ", " << count << " contacts, "
+       << (this_thread::get_id() == loop ? "on" : "off") << " the loop thread" << endl;
+  --pending;
+}
+#endif
+
+int main(void)
+{
+  try {
+    sqlite3pp::connection_pool pool("async.db", 4);
+    sqlite3pp::async_executor exec(pool, 4);
+
+    exec.execute("CREATE TABLE IF NOT EXISTS contacts (name TEXT, phone TEXT)").get();
+    cout << exec.execute("INSERT INTO contacts (name, phone) VALUES (?, ?)", "Mike", "555-1234").get() << endl;
+
+    auto rows = exec.query<string, string>("SELECT name, phone FROM contacts WHERE name = ?", "Mike");
+    size_t pending = 1;
+    rows.then([&] {
+      for (auto& [name, phone] : rows.get()) {
+        cout << name << "\t" << phone << endl;
+      }
+      --pending;
+    });
+
+    // A minimal event loop waiting on the completion descriptor.
+    while (pending > 0) {
+      pollfd pfd{exec.completion_fd(), POLLIN, 0};
+      poll(&pfd, 1, 1000);
+      exec.run_completions();
+    }
+
+#ifdef SQLITE3PP_COROUTINES
+    // Awaiting coroutines are resumed by run_completions().
+    pending = 1;
+    lookup(exec, this_thread::get_id(), pending);
+    cout << pending << " pending" << endl;
+    while (pending > 0) {
+      pollfd pfd{exec.completion_fd(), POLLIN, 0};
+      poll(&pfd, 1, 1000);
+      exec.run_completions();
+    }
+#endif
+
+    // Text parameters are copied, so the caller's buffer may go away before the task runs.
+    auto inserted = exec.execute("INSERT INTO contacts (name, phone) VALUES (?, ?)",
+                                 string("Anne").c_str(), string_view("555-0000"));
+
+    // A task without a result.
+    auto done = exec.submit(true, [](sqlite3pp::database& db) {
+      db.execute("UPDATE contacts SET phone = '555-4321' WHERE name = 'Mike'");
+    });
+    inserted.get();
+    done.get();
+    // Nothing is queued for results that were only waited for.
+    cout << exec.run_completions() << " completions" << endl;
+
+    try {
+      done.get();
+    }
+    catch (exception& ex) {
+      cout << ex.what() << endl;
+    }
+
+    for (auto& [name, phone] : exec.query<string, string>("SELECT name, phone FROM contacts ORDER BY name").get()) {
+      cout << name << "\t" << phone << endl;
+    }
+
+    exec.execute("DROP TABLE contacts").get();
+  }
+  catch (exception& ex) {
+    cout << ex.what() << endl;
+  }
+  return 0;
+}
@@ -1,5 +1,8 @@
+#include <chrono>
 #include <iostream>
+#include <thread>
 #include "sqlite3pp.h"
+#include "sqlite3ppbackup.h"
 
 #include "monolithic_examples.h"
 
@@ -24,6 +27,58 @@ int main(void)
           // sleep(250);
         }
       });
+
+    sqlite3pp::database standbydb("backup_standby.db");
+    sqlite3pp::database snapshotdb("backup_snapshot.db");
+    auto progress = [](char const* name) {
+      return [name](int remaining, int pagecount, int) {
+        cout << name << ": " << pagecount - remaining << "/" << pagecount << endl;
+      };
+    };
+    cout << db.backup({{standbydb, progress("standby")}, {snapshotdb, progress("snapshot")}}) << endl;
+
+    sqlite3pp::database jobdb("backup_job.db");
+    sqlite3pp::backup_job::options opts;
+    opts.step_budget = chrono::milliseconds(1);
+    sqlite3pp::backup_job job(db, jobdb, opts);
+    while (!job.status().done) {
+      this_thread::sleep_for(chrono::milliseconds(5));
+    }
+    auto status = job.status();
+    cout << status.pagecount - status.remaining << "/" << status.pagecount << " pages, "
+         << job.wait() << endl;
+
+    sqlite3pp::incremental_backup incremental(db, "backup_incremental.db");
+    for (int i = 0; i < 2; ++i) {
+      auto res = incremental.run();
+      cout << res.pages_written << "/" << res.pages << " pages written" << endl;
+    }
+
+    // Spread a change over several pages; only those should be written.
+    db.execute("CREATE TABLE IF NOT EXISTS backup_filler (id INTEGER PRIMARY KEY, data TEXT)");
+    {
+      sqlite3pp::transaction xct(db);
+      sqlite3pp::command cmd(db, "INSERT INTO backup_filler (data) VALUES (?)");
+      for (int i = 0; i < 100; ++i) {
+        cmd.bind(1, string(200, char('a' + i % 26)), sqlite3pp::copy);
+        cmd.execute();
+        cmd.reset();
+      }
+      xct.commit();
+    }
+    auto res = incremental.run();
+    cout << (res.pages_written > 0 ? "changed" : "no") << " pages written, "
+         << (res.pages_written < res.pages ? "not all" : "all") << " pages" << endl;
+
+    {
+      sqlite3pp::database copydb("backup_incremental.db");
+      sqlite3pp::query check(copydb, "PRAGMA integrity_check");
+      cout << (*check.begin()).get<char const*>(0) << endl;
+      sqlite3pp::query count(copydb, "SELECT count(*), max(data) FROM backup_filler");
+      auto row = *count.begin();
+      cout << row.get<int>(0) << " rows, max " << row.get<string>(1).substr(0, 3) << endl;
+    }
+    db.execute("DROP TABLE backup_filler");
   }
   catch (exception& ex) {
     cout << ex.what() << endl;
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "sqlite3pp.h"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main	sqlite3pp_blob_test_main
+#endif
+
+int main(void)
+{
+  try {
+    sqlite3pp::database db(":memory:");
+    db.execute("CREATE TABLE files (id INTEGER PRIMARY KEY, data BLOB)");
+
+    // preallocate, then stream the contents in
+    sqlite3pp::command cmd(db, "INSERT INTO files (id, data) VALUES (?, ?)");
+    for (int id = 1; id <= 3; ++id) {
+      cmd.binder() << id << sqlite3pp::zeroblob{100000};
+      cmd.execute();
+      cmd.reset();
+    }
+
+    {
+      sqlite3pp::blob_handle blob(db, "main", "files", "data", 1, true);
+      for (int id = 1; id <= 3; ++id) {
+        if (id > 1)
+          blob.reopen(id);
+        sqlite3pp::blob_streambuf buf(blob, 4096);
+        ostream out(&buf);
+        for (int i = 0; i < 10000; ++i) {
+          out << "row" << id << "-" << i % 10 << ";";
+        }
+        out.flush();
+        cout << id << ": " << out.tellp() << " of " << blob.size() << " bytes written" << endl;
+      }
+      cout << blob.write("END", 3, blob.size() - 3) << endl;
+      cout << blob.write("END", 3, blob.size()) << endl;
+    }
+
+    {
+      sqlite3pp::blob_handle blob(db, "main", "files", "data", 3, false);
+      sqlite3pp::blob_streambuf buf(blob, 4096);
+      istream in(&buf);
+      string token;
+      getline(in, token, ';');
+      cout << token << endl;
+
+      in.seekg(-3, ios_base::end);
+      getline(in, token);
+      cout << token << endl;
+
+      vector<char> all(blob.size());
+      in.clear();
+      in.seekg(0);
+      in.read(all.data(), all.size());
+      cout << in.gcount() << endl;
+    }
+
+    try {
+      sqlite3pp::blob_handle blob(db, "main", "files", "data", 1, false);
+      blob.reopen(42);
+    }
+    catch (sqlite3pp::database_error& ex) {
+      cout << ex.what() << endl;
+    }
+  }
+  catch (exception& ex) {
+    cout << ex.what() << endl;
+  }
+  return 0;
+}
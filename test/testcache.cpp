@@ -0,0 +1,52 @@
+#include <iostream>
+#include <string>
+#include "sqlite3pp.h"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main	sqlite3pp_cache_test_main
+#endif
+
+int main(void)
+{
+  try {
+    sqlite3pp::database db("test.db");
+
+    sqlite3pp::query_cache cache(db, 4);
+
+    for (int n = 0; n < 3; ++n) {
+      for (int i = 0; i < 8; ++i) {
+        string sql = "SELECT id, name FROM contacts WHERE id > " + to_string(i);
+        auto qry = cache[sql];
+        for (auto row : qry) {
+          (void)row;
+        }
+      }
+      auto qry = cache["SELECT count(*) FROM contacts"];
+      cout << (*qry.begin()).get<int>(0) << endl;
+    }
+
+    // Each use of the same SQL gets its own prepared statement, so nesting is safe.
+    auto outer = cache["SELECT id FROM contacts"];
+    for (auto row : outer) {
+      auto inner = cache["SELECT id FROM contacts"];
+      for (auto row2 : inner) {
+        cout << row.get<int>(0) << "," << row2.get<int>(0) << "\t";
+      }
+    }
+    cout << endl;
+
+    auto& stats = cache.stats();
+    cout << "entries: " << cache.size() << ", memory: " << cache.memory_used() << endl;
+    cout << "hits: " << stats.hits << ", misses: " << stats.misses
+         << ", evictions: " << stats.evictions << endl;
+  }
+  catch (exception& ex) {
+    cout << ex.what() << endl;
+  }
+  return 0;
+}
@@ -1,4 +1,8 @@
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include "sqlite3pp.h"
 #include "sqlite3ppext.h"
@@ -38,6 +42,27 @@ static std::string test6(std::string const& s1, std::string const& s2, std::stri
   return s1 + s2 + s3;
 }
 
+static size_t count_char(std::string_view s, std::string_view c)
+{
+  if (c.size() != 1)
+    throw std::invalid_argument("count_char: expected one character");
+  size_t n = 0;
+  for (char ch : s)
+    n += ch == c[0];
+  return n;
+}
+
+static std::optional<double> d1(std::optional<double> x)
+{
+  if (!x)
+    return std::nullopt;
+  return *x / 2;
+}
+
+static constexpr auto d2 = [](long long int a, long long int b) { return a * b; };
+
+static constexpr auto d3 = [](unsigned int n) { return uint64_t(n) << 40; };
+
 
 #if defined(BUILD_MONOLITHIC)
 #define main	sqlite3pp_function_test_main
@@ -71,6 +96,56 @@ int main(void)
       cout << endl;
     }
     cout << endl;
+
+    cout << func.create<count_char>("count_char", SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS) << endl;
+    cout << func.create<d1>("d1", SQLITE_DETERMINISTIC) << endl;
+    cout << func.create<+d2>("d2") << endl;
+    cout << func.create<+d3>("d3") << endl;
+
+    qry.prepare("SELECT count_char('banana', 'a'), d1(5), d1(NULL), d2(6, 7), d3(3)");
+    for (auto row : qry) {
+      cout << row.get<int>(0) << "\t" << row.get<double>(1) << "\t" << (row.get<char const*>(2) ? "?" : "NULL")
+           << "\t" << row.get<int>(3) << "\t" << row.get<long long int>(4) << endl;
+    }
+
+    sqlite3pp::query bad(db, "SELECT count_char('banana', 'an')");
+    try {
+      for (auto row : bad) {
+        (void)row;
+      }
+    }
+    catch (exception& ex) {
+      cout << ex.what() << endl;
+    }
+
+    cout << func.create_regexp() << endl;
+    qry.prepare("SELECT 'abc123' REGEXP '[0-9]+$', 'abc' REGEXP '^b', regexp('^a.c', 'abcd'), NULL REGEXP 'a'");
+    for (auto row : qry) {
+      cout << row.get<int>(0) << "\t" << row.get<int>(1) << "\t" << row.get<int>(2) << "\t"
+           << (row.get<char const*>(3) ? "?" : "NULL") << endl;
+    }
+
+    // The pattern is compiled once for the statement, not once per row.
+    int compiled = 0;
+    func.create("prefixed", [&compiled](sqlite3pp::ext::context& c) {
+      auto const& prefix = c.aux<std::string>(0, [&] { ++compiled; return c.get<std::string>(0); });
+      c.result(c.get<std::string_view>(1).substr(0, prefix.size()) == prefix ? 1 : 0);
+    }, 2);
+    qry.prepare("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+                "SELECT count(*) FROM n WHERE prefixed('1', i) AND i REGEXP '0$'");
+    for (auto row : qry) {
+      cout << row.get<int>(0) << " rows, " << compiled << " compiled" << endl;
+    }
+
+    sqlite3pp::query bad_pattern(db, "SELECT 'a' REGEXP '('");
+    try {
+      for (auto row : bad_pattern) {
+        (void)row;
+      }
+    }
+    catch (exception& ex) {
+      cout << ex.what() << endl;
+    }
   }
   catch (exception& ex) {
     cout << ex.what() << endl;
@@ -1,10 +1,20 @@
+#include <chrono>
 #include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
 #include "sqlite3pp.h"
 
 #include "monolithic_examples.h"
 
 using namespace std;
 
+static double rows_per_second(size_t rows, chrono::steady_clock::time_point start)
+{
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  return rows / elapsed.count();
+}
+
 
 #if defined(BUILD_MONOLITHIC)
 #define main	sqlite3pp_insert_test_main
@@ -46,6 +56,99 @@ int main(void)
 
       cout << cmd.execute() << endl;
     }
+
+    {
+      using namespace sqlite3pp::literals;
+
+      sqlite3pp::transaction xct(db);
+      sqlite3pp::command_cache cache(db);
+
+      for (auto name : {"EEEE", "FFFF"}) {
+        auto cmd = cache["INSERT INTO contacts (name, phone) VALUES (:name, :phone)"];
+        cout << cmd.parameter_index(":phone"_param) << endl;
+        cmd.bind(":name"_param, name, sqlite3pp::nocopy);
+        cmd[":phone"_param] = "5678";
+        cout << cmd.execute() << endl;
+      }
+
+      xct.commit();
+    }
+
+    {
+      vector<tuple<long long int, string, double>> rows;
+      for (int i = 0; i < 100000; ++i) {
+        rows.emplace_back(i, "name" + to_string(i), i * 0.5);
+      }
+
+      db.execute("CREATE TEMP TABLE bench (id INTEGER, name TEXT, score REAL)");
+      sqlite3pp::command cmd(db, "INSERT INTO bench (id, name, score) VALUES (?, ?, ?)");
+
+      auto start = chrono::steady_clock::now();
+      {
+        sqlite3pp::transaction xct(db);
+        for (auto& row : rows) {
+          cmd.binder() << get<0>(row) << get<1>(row) << get<2>(row);
+          cmd.execute();
+          cmd.reset();
+        }
+        xct.commit();
+      }
+      cout << "hand-written loop: " << rows_per_second(rows.size(), start) << " rows/s" << endl;
+
+      db.execute("DELETE FROM bench");
+
+      sqlite3pp::typed_command<long long int, string, double> typed(
+        db, "INSERT INTO bench (id, name, score) VALUES (?, ?, ?)");
+      start = chrono::steady_clock::now();
+      {
+        sqlite3pp::transaction xct(db);
+        for (auto& [id, name, score] : rows) {
+          typed.execute(id, name, score);
+        }
+        xct.commit();
+      }
+      cout << "typed_command: " << rows_per_second(rows.size(), start) << " rows/s" << endl;
+
+      db.execute("DELETE FROM bench");
+
+      start = chrono::steady_clock::now();
+      cout << cmd.execute_batch(rows, 10000) << endl;
+      cout << "execute_batch: " << rows_per_second(rows.size(), start) << " rows/s" << endl;
+
+      db.execute("DELETE FROM bench");
+
+      // No row limit: a single transaction, unless it takes longer than the interval.
+      cout << cmd.execute_batch(rows, 0, chrono::hours(1)) << endl;
+      sqlite3pp::query count(db, "SELECT count(*) FROM bench");
+      for (auto row : count) {
+        cout << row.get<int>(0) << " rows" << endl;
+      }
+
+      db.execute("DELETE FROM bench");
+
+      sqlite3pp::bulk_loader loader(db, "bench", {"id", "name", "score"});
+      start = chrono::steady_clock::now();
+      cout << loader.insert(rows) << endl;
+      cout << "bulk_loader (" << loader.block_rows() << " rows per statement): "
+           << rows_per_second(rows.size(), start) << " rows/s" << endl;
+
+      // Projections may return temporaries.
+      auto renamed = [](tuple<long long int, string, double> const& row) {
+        return make_tuple(get<0>(row) + 1000000, "renamed " + get<1>(row), get<2>(row));
+      };
+      cout << cmd.execute_batch(rows, renamed) << endl;
+      cout << loader.insert(rows, [&](auto const& row) {
+        auto t = renamed(row);
+        get<0>(t) += 1000000;
+        return t;
+      }) << endl;
+      sqlite3pp::query renamed_rows(db, "SELECT id, name FROM bench WHERE id IN (1000007, 2000007)");
+      for (auto row : renamed_rows) {
+        cout << row.get<long long int>(0) << "\t" << row.get<string>(1) << endl;
+      }
+
+      db.execute("DROP TABLE bench");
+    }
   }
   catch (exception& ex) {
     cout << ex.what() << endl;
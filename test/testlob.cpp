@@ -0,0 +1,116 @@
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "sqlite3pp.h"
+#include "sqlite3pplob.h"
+#include "sqlite3pppool.h"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main	sqlite3pp_lob_test_main
+#endif
+
+int main(void)
+{
+  try {
+    remove("lob.db");
+    sqlite3pp::connection_pool pool("lob.db", 4);
+
+    string payload;
+    for (int i = 0; payload.size() < 1000000; ++i) {
+      payload += to_string(i) + ",";
+    }
+
+    int64_t streamed, preallocated;
+    {
+      auto w = pool.writer();
+      sqlite3pp::large_object_store store(*w, "objects", 64 * 1024);
+
+      istringstream in(payload);
+      streamed = store.create(in);
+      cout << "streamed: " << store.size(streamed) << " bytes" << endl;
+
+      preallocated = store.create(payload.size());
+      auto object = store.open(preallocated, true);
+      cout << object.write(payload.data(), 100000, 0) << endl;
+      cout << object.write(payload.data() + 100000, payload.size(), 100000) << endl;
+      cout << object.write("x", 1, object.size()) << endl;
+
+      char buf[16] = {};
+      cout << object.read(buf, sizeof(buf) - 1, 65530) << " " << buf << endl;
+    }
+
+    {
+      auto w = pool.writer();
+      sqlite3pp::large_object_store tiny(*w, "tiny_chunks", 1);
+      try {
+        tiny.create(uint64_t(UINT32_MAX) + 1);
+      }
+      catch (sqlite3pp::database_error& ex) {
+        cout << ex.what() << " (" << (ex.error_code == SQLITE_TOOBIG) << ")" << endl;
+      }
+
+      // A missing chunk fails the access without breaking the handle for the others.
+      auto id = tiny.create(3);
+      tiny.open(id, true).write("abc", 3, 0);
+      w->execute(("DELETE FROM tiny_chunks_chunks WHERE rowid = " +
+                  to_string(sqlite3pp::large_object_store::chunk_rowid(id, 1))).c_str());
+      auto object = tiny.open(id);
+      char c = 0;
+      cout << object.read(&c, 1, 0) << " " << c << endl;
+      try {
+        object.read(&c, 1, 1);
+      }
+      catch (sqlite3pp::database_error& ex) {
+        cout << ex.what() << endl;
+      }
+      cout << object.read(&c, 1, 2) << " " << c << endl;
+      cout << object.read(&c, 1, 0) << " " << c << endl;
+
+      w->execute(("UPDATE tiny_chunks SET chunk_size = 0 WHERE id = " + to_string(id)).c_str());
+      try {
+        tiny.open(id);
+      }
+      catch (sqlite3pp::database_error& ex) {
+        cout << ex.what() << " (" << (ex.error_code == SQLITE_CORRUPT) << ")" << endl;
+      }
+    }
+
+    {
+      auto w = pool.writer();
+      sqlite3pp::large_object_store store(*w, "objects", 64 * 1024);
+      w.release();
+
+      for (auto id : {streamed, preallocated}) {
+        vector<char> data(payload.size());
+        cout << store.read(pool, id, data.data(), data.size()) << " bytes read in parallel, "
+             << (string(data.begin(), data.end()) == payload ? "equal" : "different") << endl;
+      }
+
+      vector<char> part(10);
+      cout << store.read(pool, streamed, part.data(), 100, payload.size() - 10) << endl;
+
+      auto w2 = pool.writer();
+      store.remove(streamed);
+      try {
+        store.size(streamed);
+      }
+      catch (sqlite3pp::database_error& ex) {
+        cout << ex.what() << endl;
+      }
+    }
+    remove("lob.db");
+    remove("lob.db-wal");
+    remove("lob.db-shm");
+  }
+  catch (exception& ex) {
+    cout << ex.what() << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "sqlite3pp.h"
+#include "sqlite3pppool.h"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main	sqlite3pp_pool_test_main
+#endif
+
+int main(void)
+{
+  try {
+    sqlite3pp::connection_pool pool(
+      "pool.db", 4,
+      [](sqlite3pp::connection_pool::connection& conn) {
+        conn.functions.create<int (int)>("twice", [](int i){ return i * 2; });
+      });
+
+    {
+      auto w = pool.writer();
+      w->execute("CREATE TABLE IF NOT EXISTS numbers (n INTEGER)");
+      sqlite3pp::transaction xct(*w);
+      sqlite3pp::command cmd(*w, "INSERT INTO numbers (n) VALUES (?)");
+      for (int i = 0; i < 100; ++i) {
+        cmd.binder() << i;
+        cmd.execute();
+        cmd.reset();
+      }
+      xct.commit();
+    }
+
+    vector<long long int> sums(8);
+    vector<thread> threads;
+    for (int t = 0; t < 8; ++t) {
+      threads.emplace_back([&pool, &sums, t] {
+        auto r = pool.reader();
+        sqlite3pp::query qry(*r, "SELECT sum(twice(n)) FROM numbers");
+        for (auto row : qry) {
+          sums[t] = row.get<long long int>(0);
+        }
+      });
+    }
+    for (auto& th : threads) {
+      th.join();
+    }
+    for (size_t t = 0; t < sums.size(); ++t) {
+      cout << "thread " << t << ": " << sums[t] << endl;
+    }
+
+    auto r = pool.reader();
+    auto moved = std::move(r);
+    moved.release();
+    cout << bool(r) << bool(moved) << endl;
+    try {
+      moved->execute("SELECT 1");
+    }
+    catch (exception& ex) {
+      cout << ex.what() << endl;
+    }
+
+    try {
+      sqlite3pp::connection_pool no_readers("pool.db", 0);
+    }
+    catch (exception& ex) {
+      cout << ex.what() << endl;
+    }
+  }
+  catch (exception& ex) {
+    cout << ex.what() << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "sqlite3pp.h"
+#include "sqlite3pppool.h"
+#include "sqlite3ppprofile.h"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main	sqlite3pp_profile_test_main
+#endif
+
+int main(void)
+{
+  try {
+    sqlite3pp::profiler prof;
+    sqlite3pp::connection_pool pool(
+      "profile.db", 4,
+      [&prof](sqlite3pp::connection_pool::connection& conn) {
+        prof.attach(conn.db);
+      });
+
+    {
+      auto w = pool.writer();
+      w->execute("DROP TABLE IF EXISTS numbers");
+      w->execute("CREATE TABLE numbers (n INTEGER, s TEXT)");
+      sqlite3pp::transaction xct(*w);
+      for (int i = 0; i < 1000; ++i) {
+        w->executef("INSERT INTO numbers (n, s) VALUES (%d, 'n%d')", i, i);
+      }
+      xct.commit();
+    }
+
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&pool] {
+        auto r = pool.reader();
+        for (int i = 0; i < 100; ++i) {
+          sqlite3pp::query qry(*r, "SELECT s FROM numbers WHERE n % 10 = ? ORDER BY s");
+          qry.bind(1, i % 10);
+          for (auto row : qry) {
+            (void)row;
+          }
+        }
+      });
+    }
+    for (auto& th : threads) {
+      th.join();
+    }
+
+    prof.report(cout, 5);
+    prof.write_prometheus("profile.prom");
+  }
+  catch (exception& ex) {
+    cout << ex.what() << endl;
+  }
+  return 0;
+}
@@ -53,6 +53,46 @@ int main(void)
 	r.getter() >> sqlite3pp::ignore >> name >> phone;
 	cout << id << "\t" << name << "\t" << phone << endl;
       }
+      cout << endl;
+
+      qry.reset();
+
+      for (auto [id, name, phone] : qry.as<int, std::string_view, std::string_view>()) {
+	cout << id << "\t" << name << "\t" << phone << endl;
+      }
+      cout << endl;
+
+      qry.reset();
+
+      struct contact {
+	long long int id;
+	std::string name, phone;
+      };
+      for (contact c : qry.as_struct<contact, long long int, std::string, std::string>()) {
+	cout << c.id << "\t" << c.name << "\t" << c.phone << endl;
+      }
+      cout << endl;
+
+      qry.reset();
+
+      sqlite3pp::column_batch batch;
+      size_t n;
+      do {
+	n = qry.fetch_columns(batch, 2);
+	for (size_t r = 0; r < n; ++r) {
+	  cout << batch[0].integers[r] << "\t" << batch[1].bytes(r) << "\t" << batch[2].bytes(r) << endl;
+	}
+      } while (n == 2);
+    }
+
+    {
+      sqlite3pp::typed_query<std::tuple<std::string_view>, std::tuple<std::string, std::string>> qry(
+        db, "SELECT name, phone FROM contacts WHERE name <> ?");
+
+      for (auto [name, phone] : qry("Mike")) {
+	cout << name << "\t" << phone << endl;
+      }
+      cout << endl;
     }
   }
   catch (exception& ex) {
@@ -0,0 +1,53 @@
+#include <cstdio>
+#include <iostream>
+#include "sqlite3pp.h"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main	sqlite3pp_serialize_test_main
+#endif
+
+static void count_contacts(sqlite3pp::database& db)
+{
+  sqlite3pp::query qry(db, "SELECT count(*) FROM contacts");
+  for (auto row : qry) {
+    cout << row.get<int>(0) << " contacts" << endl;
+  }
+}
+
+int main(void)
+{
+  try {
+    sqlite3pp::database db("test.db");
+
+    auto image = db.serialize();
+    cout << image.size() << " bytes" << endl;
+
+    sqlite3pp::database memdb(":memory:");
+    cout << memdb.deserialize(std::move(image)) << endl;
+    count_contacts(memdb);
+    memdb.execute("INSERT INTO contacts (name, phone) VALUES ('serialized', '0000')");
+    count_contacts(memdb);
+
+    auto view = memdb.serialize("main", SQLITE_SERIALIZE_NOCOPY);
+    cout << view.size() << " bytes, no copy" << endl;
+
+    db.execute("VACUUM INTO 'image.db'");
+    {
+      auto mapped = sqlite3pp::database_image::map("image.db");
+      sqlite3pp::database mapdb(":memory:");
+      cout << mapdb.deserialize(mapped) << endl;
+      count_contacts(mapdb);
+      cout << mapdb.execute("DELETE FROM contacts") << " " << mapdb.error_msg() << endl;
+    }
+    remove("image.db");
+  }
+  catch (exception& ex) {
+    cout << ex.what() << endl;
+  }
+  return 0;
+}
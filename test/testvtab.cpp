@@ -0,0 +1,217 @@
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include "sqlite3pp.h"
+#include "sqlite3ppvtab.h"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// A std::map exposed as a table; lookups and range scans on the key use the map.
+class kv_table
+{
+ public:
+  explicit kv_table(map<long long, string> const& m) : m_(m) {}
+
+  string schema() const { return "CREATE TABLE x(key INTEGER, value TEXT)"; }
+
+  int best_index(sqlite3pp::ext::index_info& info)
+  {
+    int eq = -1, lower = -1;
+    for (int i = 0; i < info.constraint_count(); ++i) {
+      if (!info.constraint_usable(i) || (info.constraint_column(i) != 0 && info.constraint_column(i) != -1))
+        continue;
+      if (info.constraint_op(i) == SQLITE_INDEX_CONSTRAINT_EQ)
+        eq = i;
+      else if (info.constraint_op(i) == SQLITE_INDEX_CONSTRAINT_GE)
+        lower = i;
+    }
+    if (eq >= 0) {
+      info.use(eq, 1);
+      info.index(1);
+      info.unique();
+      info.estimate(1, 1);
+    }
+    else if (lower >= 0) {
+      info.use(lower, 1);
+      info.index(2);
+      info.estimate(double(m_.size()) / 4, (long long)(m_.size() / 4));
+    }
+    else {
+      info.estimate(double(m_.size()), (long long)m_.size());
+    }
+    if (info.order_by_count() == 1 && info.order_by_column(0) == 0 && !info.order_by_desc(0))
+      info.order_by_consumed();
+    return SQLITE_OK;
+  }
+
+  struct cursor
+  {
+    explicit cursor(kv_table& t) : m_(t.m_) {}
+
+    int filter(int idx_num, char const*, sqlite3pp::ext::context& args)
+    {
+      end_ = m_.end();
+      if (idx_num == 1) {
+        it_ = m_.find(args.get<long long>(0));
+        if (it_ != end_)
+          end_ = std::next(it_);
+      }
+      else if (idx_num == 2)
+        it_ = m_.lower_bound(args.get<long long>(0));
+      else
+        it_ = m_.begin();
+      return SQLITE_OK;
+    }
+
+    int next() { ++it_; return SQLITE_OK; }
+    bool eof() const { return it_ == end_; }
+
+    void column(sqlite3pp::ext::context& ctx, int col) const
+    {
+      if (col == 0)
+        ctx.result(it_->first);
+      else
+        ctx.result(it_->second);
+    }
+
+    long long rowid() const { return it_->first; }
+
+    map<long long, string> const& m_;
+    map<long long, string>::const_iterator it_, end_;
+  };
+
+ private:
+  map<long long, string> const& m_;
+};
+
+#if defined(BUILD_MONOLITHIC)
+#define main	sqlite3pp_vtab_test_main
+#endif
+
+int main(void)
+{
+  try {
+    map<long long, string> m;
+    for (long long i = 1; i <= 10; ++i)
+      m[i * 10] = "value " + to_string(i * 10);
+
+    sqlite3pp::database db(":memory:");
+    sqlite3pp::ext::module mod(db);
+    cout << mod.create<kv_table>("kv", [&](vector<string> const&) { return make_unique<kv_table>(m); }) << endl;
+
+    sqlite3pp::query qry(db, "SELECT key, value FROM kv WHERE key = 30");
+    for (auto row : qry) {
+      cout << row.get<long long>(0) << "\t" << row.get<string>(1) << endl;
+    }
+
+    qry.prepare("SELECT key, value FROM kv WHERE key >= 75 ORDER BY key");
+    for (auto row : qry) {
+      cout << row.get<long long>(0) << "\t" << row.get<string>(1) << endl;
+    }
+
+    // The map's contents are read at query time, not copied when the table is created.
+    m[35] = "value 35";
+    db.execute("CREATE TEMP TABLE wanted(key INTEGER)");
+    db.execute("INSERT INTO wanted VALUES (20), (35), (99)");
+    qry.prepare("SELECT w.key, kv.value FROM wanted w JOIN kv ON kv.key = w.key");
+    for (auto row : qry) {
+      cout << row.get<long long>(0) << "\t" << row.get<string>(1) << endl;
+    }
+
+    cout << db.execute("CREATE VIRTUAL TABLE temp.kv2 USING kv(unused)") << endl;
+    qry.prepare("SELECT count(*), sum(key) FROM kv2");
+    for (auto row : qry) {
+      cout << row.get<int>(0) << "\t" << row.get<long long>(1) << endl;
+    }
+
+    // Table-valued functions: rows are generated as the query steps.
+    sqlite3pp::ext::table_function tf(db);
+    cout << tf.create<tuple<long long> (long long, long long)>(
+      "series", {"value"}, {"start", "stop"}, [](long long start, long long stop) {
+        return [=]() mutable -> optional<tuple<long long>> {
+          if (start > stop)
+            return nullopt;
+          return make_tuple(start++);
+        };
+      }) << endl;
+    cout << tf.create<tuple<int, string> (string, string)>(
+      "split", {"n", "part"}, {"text", "sep"}, [](string text, string sep) {
+        size_t pos = 0;
+        int n = 0;
+        return [=]() mutable -> optional<tuple<int, string>> {
+          if (pos > text.size() || sep.empty())
+            return nullopt;
+          size_t end = text.find(sep, pos);
+          if (end == string::npos)
+            end = text.size();
+          auto part = make_tuple(++n, text.substr(pos, end - pos));
+          pos = end + sep.size();
+          return part;
+        };
+      }) << endl;
+
+    // Any integral type can be a column or an argument.
+    cout << tf.create<tuple<size_t, unsigned int, long> (unsigned int)>(
+      "squares", {"i", "square", "negative"}, {"n"}, [](unsigned int n) {
+        size_t i = 0;
+        return [=]() mutable -> optional<tuple<size_t, unsigned int, long>> {
+          if (i >= n)
+            return nullopt;
+          ++i;
+          return make_tuple(i, unsigned(i * i), -long(i));
+        };
+      }) << endl;
+    qry.prepare("SELECT i, square, negative FROM squares(3)");
+    for (auto row : qry) {
+      cout << row.get<int>(0) << "\t" << row.get<int>(1) << "\t" << row.get<int>(2) << endl;
+    }
+
+    // View arguments stay valid for the generator and the hidden columns of every row.
+    cout << tf.create<tuple<string> (string_view, char const*)>(
+      "chars", {"ch"}, {"text", "prefix"}, [](string_view text, char const* prefix) {
+        size_t i = 0;
+        return [=]() mutable -> optional<tuple<string>> {
+          if (i >= text.size())
+            return nullopt;
+          return make_tuple(prefix + string(1, text[i++]));
+        };
+      }) << endl;
+    qry.prepare("SELECT ch, text, prefix FROM chars(upper(?), ? || ':')");
+    qry.bind(1, string("abc"), sqlite3pp::copy);
+    qry.bind(2, string("x"), sqlite3pp::copy);
+    for (auto row : qry) {
+      cout << row.get<string>(0) << "\t" << row.get<string>(1) << "\t" << row.get<string>(2) << endl;
+    }
+
+    qry.prepare("SELECT value FROM series(?, ?) WHERE value % 2 = 0");
+    qry.bind(1, 1);
+    qry.bind(2, 9);
+    for (auto row : qry) {
+      cout << row.get<long long>(0) << " ";
+    }
+    cout << endl;
+
+    qry.prepare("SELECT n, part, text FROM split('a,bb,,ccc', ',')");
+    for (auto row : qry) {
+      cout << row.get<int>(0) << "\t" << row.get<string>(1) << "\t" << row.get<string>(2) << endl;
+    }
+
+    qry.prepare("SELECT w.key, s.value FROM wanted w, series s WHERE s.start = w.key AND s.stop = w.key + 1");
+    for (auto row : qry) {
+      cout << row.get<long long>(0) << "\t" << row.get<long long>(1) << endl;
+    }
+
+    qry.prepare("SELECT * FROM series(1)");
+    cout << db.error_msg() << endl;
+  }
+  catch (exception& ex) {
+    cout << ex.what() << endl;
+  }
+  return 0;
+}
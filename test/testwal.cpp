@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <iostream>
+#include "sqlite3pp.h"
+#include "sqlite3ppwal.h"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main	sqlite3pp_wal_test_main
+#endif
+
+static void print(sqlite3pp::checkpoint_manager::stats const& s)
+{
+  cout << "wal: " << s.wal_frames << " frames, " << s.frames_behind << " behind; "
+       << "checkpoints: " << s.passive << " passive, " << s.restart << " restart, "
+       << s.truncate << " truncate, " << s.busy << " busy; "
+       << s.throttled << " commits throttled" << endl;
+}
+
+int main(void)
+{
+  try {
+    remove("wal.db");
+    sqlite3pp::database db("wal.db");
+    db.execute("PRAGMA journal_mode=WAL");
+    db.set_busy_timeout(5000);
+    db.execute("CREATE TABLE log (n INTEGER, msg TEXT)");
+
+    sqlite3pp::checkpoint_manager::options opts;
+    opts.passive_frames = 100;
+    opts.restart_frames = 400;
+    opts.max_frames_behind = 300;
+    opts.throttle_timeout = chrono::milliseconds(5);
+    opts.busy_timeout = chrono::milliseconds(10);
+    sqlite3pp::checkpoint_manager manager("wal.db", opts);
+    manager.attach(db);
+
+    sqlite3pp::command cmd(db, "INSERT INTO log (n, msg) VALUES (?, randomblob(2000))");
+    for (int i = 0; i < 1000; ++i) {
+      cmd.bind(1, i);
+      cmd.execute();
+      cmd.reset();
+    }
+    manager.request();
+    this_thread::sleep_for(chrono::milliseconds(100));
+    print(manager.status());
+
+    {
+      // A long reader keeps checkpoints from catching up, so writers get throttled.
+      sqlite3pp::database reader("wal.db", SQLITE_OPEN_READONLY);
+      sqlite3pp::transaction xct(reader);
+      sqlite3pp::query qry(reader, "SELECT count(*) FROM log");
+      cout << (*qry.begin()).get<int>(0) << " rows" << endl;
+      for (int i = 0; i < 300; ++i) {
+        cmd.bind(1, i);
+        cmd.execute();
+        cmd.reset();
+      }
+      print(manager.status());
+    }
+
+    manager.detach(db);
+
+    {
+      // After a RESTART, the WAL starts over and all of it is behind, even once it grows
+      // past the size of the log that was checkpointed.
+      sqlite3pp::checkpoint_manager::options manual;
+      manual.passive_frames = 1000000;
+      manual.restart_frames = 1;
+      manual.truncate = false;
+      manual.max_frames_behind = 0;
+      sqlite3pp::checkpoint_manager restarter("wal.db", manual);
+      restarter.attach(db);
+      restarter.request();
+      this_thread::sleep_for(chrono::milliseconds(100));
+      auto before = restarter.status();
+      cout << "restarted: " << before.restart << ", " << before.frames_behind << " behind" << endl;
+      auto old_frames = before.wal_frames;
+      for (int i = 0; restarter.status().wal_frames <= old_frames + 10; ++i) {
+        cmd.bind(1, i);
+        cmd.execute();
+        cmd.reset();
+      }
+      auto after = restarter.status();
+      cout << "grown past the old log, all behind: " << (after.frames_behind == after.wal_frames) << endl;
+      restarter.detach(db);
+    }
+
+    remove("wal.db");
+    remove("wal.db-wal");
+    remove("wal.db-shm");
+  }
+  catch (exception& ex) {
+    cout << ex.what() << endl;
+  }
+  return 0;
+}